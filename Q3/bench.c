@@ -0,0 +1,464 @@
+/* ******************************************************************
+ dvbench: how fast the emulator is, and how it scales.
+
+ Microbenchmarks time the hot paths on their own:
+   insertevent   hold model (take the earliest event, put it back a
+                 random time later) with 1k and 100k events pending,
+                 for every event list backend
+   tolayer2      sending a full cost vector to a neighbor
+   rtupdate      a router taking in a vector that changes nothing
+                 (legacy), and one that changes every route (bf)
+
+ Macro benchmarks run simulations on random networks made by
+ topo_random() (a ring plus as many chords as nodes) for a window of
+ simulated time (-e), or to quiescence if that comes first, and report
+ the events handled in it per second, ns per event and peak RSS.  On
+ large networks the initial convergence goes on for far longer than
+ anyone wants to wait, with an event list that keeps growing, so the
+ window is what keeps a run bounded; the work per event grows with the
+ network, so later windows would only be slower.  Each size runs in
+ its own process, so its RSS is its own and a size that still takes
+ too long (-T) can be killed.
+
+ Sizes needing more than half the memory of the machine are skipped
+ and reported with the memory they would have needed, which for n
+ nodes and e directed links (twice the links) is about
+
+     4ne + 12n^2                  a column of n costs per neighbor, and
+                                  three vectors of n per router
+   + 4ne                          the vectors last heard (not legacy, or -d)
+   + 4ne or 4n^2                  -d: what was last sent (poison or not)
+   + e(1 + 3*window) * (s + 4n)   the pending updates, each a struct
+                                  event of s bytes and a vector (8n with -d)
+
+ bytes.  The pending updates are most of it, and grow with the window
+ at about the rate the last term says; the estimate is within a few
+ percent of the peak RSS measured up to 4096 nodes.
+
+   dvbench [-o results.json] [-n size,size,...] [-e time] [-T seconds]
+           [-s seed] [-q backend] [-p legacy|bf|poison] [-d] [-m | -M]
+
+ -m runs only the microbenchmarks, -M only the macro benchmarks.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "distance_vector.h"
+#include "router.h"
+#include "topology.h"
+#include "scenario.h"
+#include "rng.h"
+#include "sim.h"
+
+#define MINTIME     0.25            /* seconds each microbenchmark runs */
+#define BATCH       10000           /* operations timed at once */
+
+static const int defaultsizes[] = { 4, 16, 64, 256, 1024, 4096, 16384, 100000 };
+static const char *const backends[] = { "list", "heap", "dheap", "calendar" };
+
+struct result {
+  char name[32];
+  char backend[16];
+  int pending;
+  unsigned long ops;
+  double seconds;
+};
+
+struct macro {
+  int nodes;
+  int links;
+  int status;                   /* 0 ran, 1 skipped, 2 timed out/failed */
+  double bytes;                 /* estimated memory of the run */
+  unsigned long events;         /* handled in the window */
+  float simtime;                /* the window, or when it went quiet */
+  double seconds;
+  long peakrss;                 /* kB */
+};
+
+static struct result micro[32];
+static int nmicro;
+static uint64_t seed = 1;
+static int timeout = 600;
+static float window = 2.0;      /* simulated time each size runs for */
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the network and settings the simulations to come run on */
+static void usetopology(int n, int chords)
+{
+  if (topo != NULL)
+    topo_free(topo);
+  topo = topo_random(n, chords, seed);
+  if (topo == NULL) {
+    printf("cannot make a network of %d nodes\n", n);
+    exit(1);
+  }
+  nnodes = topo->nnodes;
+}
+
+static void drain(struct sim *sim)
+{
+  struct event *p;
+
+  while ((p = sim_popevent(sim)) != NULL)
+    freeevent(p);
+}
+
+static struct result *newresult(const char *name, const char *backend,
+                                int pending)
+{
+  struct result *r = &micro[nmicro++];
+
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  snprintf(r->backend, sizeof(r->backend), "%s", backend);
+  r->pending = pending;
+  r->ops = 0;
+  r->seconds = 0.0;
+  return r;
+}
+
+/****************************** microbenchmarks ****************************/
+
+static void bench_insertevent(const char *backend, int pending)
+{
+  const char *saved = evqspec;
+  struct result *res;
+  struct sim *sim;
+  struct event *p;
+  uint64_t sm = seed;
+  double t0;
+  int i;
+
+  evqspec = backend;
+  sim = sim_create(seed);
+  sim_enter(sim, 0);
+  drain(sim);
+  for (i = 0; i < pending; i++) {
+    p = newevent();
+    p->evtype = FROM_LAYER2;
+    p->eventity = 0;
+    p->evtime = 1000.0f * rng_float(splitmix64(&sm));
+    insertevent(p);
+  }
+  res = newresult("insertevent", backend, pending);
+  do {
+    t0 = now();
+    for (i = 0; i < BATCH; i++) {
+      p = sim_popevent(sim);
+      p->evtime += 1000.0f * rng_float(splitmix64(&sm));
+      insertevent(p);
+    }
+    res->seconds += now() - t0;
+    res->ops += BATCH;
+  } while (res->seconds < MINTIME);
+  drain(sim);
+  sim_destroy(sim);
+  evqspec = saved;
+}
+
+static void bench_tolayer2(void)
+{
+  struct result *res;
+  struct router *r;
+  struct rtpkt pkt;
+  struct sim *sim;
+  double t0;
+  int i;
+
+  sim = sim_create(seed);
+  sim_enter(sim, 0);
+  drain(sim);
+  r = sim_router(sim, 0);
+  for (i = 0; i < nnodes; i++)
+    r->mincosts[i] = r->best[i];
+  creatertpkt(&pkt, 0, r->neighbors[0], r->mincosts);
+  res = newresult("tolayer2", evqspec, 0);
+  do {
+    t0 = now();
+    for (i = 0; i < BATCH; i++)
+      tolayer2(pkt);
+    res->seconds += now() - t0;
+    res->ops += BATCH;
+    drain(sim);
+  } while (res->seconds < MINTIME);
+  sim_destroy(sim);
+}
+
+/* router 0 hears from its first neighbor, alternating between the
+   neighbor's converged vector and, with change set, one worse by 5 to
+   every node, so that every update moves routes and is passed on */
+static void bench_rtupdate(const char *name, int policy, int change)
+{
+  int saved = rtpolicy;
+  struct result *res;
+  struct router *r, *from;
+  struct rtpkt pkt[2];
+  struct sim *sim;
+  int *vec, i, k;
+  double t0;
+
+  rtpolicy = policy;
+  sim = sim_create(seed);
+  sim_run(sim);
+  sim_enter(sim, 0);
+  r = sim_router(sim, 0);
+  from = sim_router(sim, r->neighbors[0]);
+  vec = malloc(2 * nnodes * sizeof(int));
+  for (i = 0; i < nnodes; i++) {
+    vec[i] = from->best[i];
+    vec[nnodes + i] = change && vec[i] + 5 < INFINITY ? vec[i] + 5 : vec[i];
+  }
+  for (k = 0; k < 2; k++)
+    creatertpkt(&pkt[k], from->id, 0, vec + k * nnodes);
+  res = newresult(name, evqspec, 0);
+  do {
+    t0 = now();
+    for (i = 0; i < BATCH / 10; i++)
+      rtupdate(r, &pkt[i & 1]);
+    res->seconds += now() - t0;
+    res->ops += BATCH / 10;
+    drain(sim);
+  } while (res->seconds < MINTIME);
+  free(vec);
+  sim_destroy(sim);
+  rtpolicy = saved;
+}
+
+static void runmicro(void)
+{
+  int i;
+
+  usetopology(64, 64);
+  for (i = 0; i < (int)(sizeof(backends) / sizeof(backends[0])); i++) {
+    bench_insertevent(backends[i], 1000);
+    if (strcmp(backends[i], "list") != 0)      /* O(n) inserts */
+      bench_insertevent(backends[i], 100000);
+  }
+  bench_tolayer2();
+  bench_rtupdate("rtupdate_nochange", RT_LEGACY, 0);
+  bench_rtupdate("rtupdate_change", RT_BELLMANFORD, 1);
+
+  printf("%-18s %-9s %7s %12s %10s\n", "benchmark", "queue", "pending",
+         "ops", "ns/op");
+  for (i = 0; i < nmicro; i++)
+    printf("%-18s %-9s %7d %12lu %10.1f\n", micro[i].name, micro[i].backend,
+           micro[i].pending, micro[i].ops, 1e9 * micro[i].seconds / micro[i].ops);
+}
+
+/***************************** macro benchmarks *****************************/
+
+static double physmem(void)
+{
+  return (double)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+}
+
+/* what a run of the window takes, see the top of the file */
+static double runbytes(const struct topology *t)
+{
+  double n = t->nnodes, e = t->nedges, v = deltaupdates ? 2 : 1;
+  double bytes;
+
+  bytes = 4 * n * e + 12 * n * n;                 /* tables, vectors */
+  if (rtpolicy != RT_LEGACY || deltaupdates)
+    bytes += 4 * n * e;                           /* heard */
+  if (deltaupdates)
+    bytes += 4 * n * (rtpolicy == RT_POISON ? e : n);     /* sent */
+  return bytes + e * (1 + 3 * window) * (sizeof(struct event) + 4 * v * n);
+}
+
+static void runone(struct macro *m, int fd)
+{
+  struct rusage ru;
+  struct sim *sim;
+  double t0;
+
+  alarm(timeout);
+  t0 = now();
+  sim = sim_create(seed);
+  sim_rununtil(sim, window);
+  m->seconds = now() - t0;
+  m->events = sim_events(sim) - sim_pending(sim);
+  m->simtime = sim_pending(sim) ? window : sim_time(sim);
+  sim_destroy(sim);
+  getrusage(RUSAGE_SELF, &ru);
+  m->peakrss = ru.ru_maxrss;
+  if (write(fd, m, sizeof(*m)) != (ssize_t)sizeof(*m))
+    _exit(1);
+  _exit(0);
+}
+
+static void runmacro(struct macro *m)
+{
+  int fd[2], status;
+  pid_t pid;
+
+  usetopology(m->nodes, m->nodes);
+  m->links = topo->nedges / 2;
+  m->bytes = runbytes(topo);
+  if (m->bytes > physmem() / 2) {
+    m->status = 1;
+    printf("%8d %8d   skipped, needs about %.1f GB\n",
+           m->nodes, m->links, m->bytes / 1e9);
+    return;
+  }
+  fflush(stdout);
+  if (pipe(fd) < 0 || (pid = fork()) < 0) {
+    perror("dvbench");
+    exit(1);
+  }
+  if (pid == 0) {
+    close(fd[0]);
+    runone(m, fd[1]);
+  }
+  close(fd[1]);
+  m->status = 2;
+  if (read(fd[0], m, sizeof(*m)) == (ssize_t)sizeof(*m))
+    m->status = 0;
+  close(fd[0]);
+  waitpid(pid, &status, 0);
+  if (m->status != 0) {
+    printf("%8d %8d   did not finish within %d s\n", m->nodes, m->links,
+           timeout);
+    return;
+  }
+  printf("%8d %8d %8.2f %12lu %9.3f %12.0f %9.1f %10ld\n", m->nodes,
+         m->links, m->simtime, m->events, m->seconds,
+         m->events / m->seconds, 1e9 * m->seconds / m->events, m->peakrss);
+}
+
+/*********************************** output *********************************/
+
+static void writejson(const char *path, struct macro *m, int nmacro)
+{
+  FILE *fp;
+  int i;
+
+  fp = fopen(path, "w");
+  if (fp == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(fp, "{\n  \"seed\": %llu,\n  \"window\": %.3f,\n"
+          "  \"queue\": \"%s\",\n"
+          "  \"policy\": \"%s\",\n  \"delta_updates\": %s,\n",
+          (unsigned long long)seed, window, evqspec,
+          rtpolicy == RT_POISON ? "poison" :
+          rtpolicy == RT_BELLMANFORD ? "bf" : "legacy",
+          deltaupdates ? "true" : "false");
+  fprintf(fp, "  \"micro\": [");
+  for (i = 0; i < nmicro; i++)
+    fprintf(fp, "%s\n    {\"name\": \"%s\", \"queue\": \"%s\", "
+            "\"pending\": %d, \"ops\": %lu, \"ns_per_op\": %.2f}",
+            i ? "," : "", micro[i].name, micro[i].backend, micro[i].pending,
+            micro[i].ops, 1e9 * micro[i].seconds / micro[i].ops);
+  fprintf(fp, "%s],\n  \"macro\": [", nmicro ? "\n  " : "");
+  for (i = 0; i < nmacro; i++) {
+    fprintf(fp, "%s\n    {\"nodes\": %d, \"links\": %d, ", i ? "," : "",
+            m[i].nodes, m[i].links);
+    if (m[i].status == 0)
+      fprintf(fp, "\"sim_time\": %.3f, \"events\": %lu, "
+              "\"seconds\": %.6f, \"events_per_sec\": %.0f, "
+              "\"ns_per_event\": %.2f, \"bytes_estimated\": %.0f, "
+              "\"peak_rss_kb\": %ld}",
+              m[i].simtime, m[i].events, m[i].seconds,
+              m[i].events / m[i].seconds, 1e9 * m[i].seconds / m[i].events,
+              m[i].bytes, m[i].peakrss);
+    else
+      fprintf(fp, "\"skipped\": \"%s\", \"bytes_needed\": %.0f}",
+              m[i].status == 1 ? "memory" : "timeout", m[i].bytes);
+  }
+  fprintf(fp, "%s]\n}\n", nmacro ? "\n  " : "");
+  fclose(fp);
+}
+
+static void usage(const char *prog)
+{
+  printf("usage: %s [-o results.json] [-n size,size,...] [-e time]\n"
+         "       [-T seconds] [-s seed] [-q backend] [-p legacy|bf|poison]\n"
+         "       [-d] [-m | -M]\n",
+         prog);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const char *out = NULL, *sizes = NULL;
+  struct macro *m;
+  int c, i, nmacro, domicro = 1, domacro = 1;
+  char *s, *end;
+
+  while ((c = getopt(argc, argv, "o:n:e:T:s:q:p:dmM")) != -1) {
+    switch (c) {
+      case 'o': out = optarg; break;
+      case 'n': sizes = optarg; break;
+      case 'e': window = atof(optarg); break;
+      case 'T': timeout = atoi(optarg); break;
+      case 's': seed = strtoull(optarg, NULL, 0); break;
+      case 'q': evqspec = optarg; break;
+      case 'p':
+        if (strcmp(optarg, "legacy") == 0) rtpolicy = RT_LEGACY;
+        else if (strcmp(optarg, "bf") == 0) rtpolicy = RT_BELLMANFORD;
+        else if (strcmp(optarg, "poison") == 0) rtpolicy = RT_POISON;
+        else usage(argv[0]);
+        break;
+      case 'd': deltaupdates = 1; break;
+      case 'm': domacro = 0; break;
+      case 'M': domicro = 0; break;
+      default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || timeout < 1 || window <= 0.0)
+    usage(argv[0]);
+  TRACE = 0;
+  scenario = scenario_fromchanges(0, NULL);
+
+  m = calloc(64, sizeof(*m));
+  nmacro = 0;
+  if (sizes == NULL)
+    for (i = 0; i < (int)(sizeof(defaultsizes) / sizeof(defaultsizes[0])); i++)
+      m[nmacro++].nodes = defaultsizes[i];
+  else
+    for (s = (char *)sizes; *s != '\0' && nmacro < 64; s = end) {
+      m[nmacro].nodes = (int)strtol(s, &end, 10);
+      if (end == s || m[nmacro].nodes < 1)
+        usage(argv[0]);
+      nmacro++;
+      if (*end == ',')
+        end++;
+    }
+
+  /* the macro benchmarks go first, so that the processes they fork
+     start out as small as dvbench does */
+  if (domacro) {
+    printf("%8s %8s %8s %12s %9s %12s %9s %10s\n", "nodes", "links",
+           "sim time", "events", "seconds", "events/s", "ns/event",
+           "peakRSS kB");
+    for (i = 0; i < nmacro; i++)
+      runmacro(&m[i]);
+    if (domicro)
+      printf("\n");
+  }
+  else
+    nmacro = 0;
+  if (domicro)
+    runmicro();
+  if (out != NULL)
+    writejson(out, m, nmacro);
+  scenario_free(scenario);
+  if (topo != NULL)
+    topo_free(topo);
+  free(m);
+  return 0;
+}
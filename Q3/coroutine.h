@@ -0,0 +1,58 @@
+/* ******************************************************************
+ Stackless coroutines, in the style of protothreads.  A coroutine is a
+ function whose body sits between CO_BEGIN() and CO_END(): CO_AWAIT()
+ returns to whoever called it, and the next call carries on right after
+ the await, inside whatever loops it was in.  All a coroutine keeps
+ between calls is its struct coroutine, two ints, so every router of a
+ 100k node network can run one without a stack of its own.
+
+ The price of having no stack: local variables do not survive an
+ await, so state that must goes in the struct the coroutine works on,
+ and the body may not await from inside a switch of its own.  Every
+ await names its resume point, a small number unique within the
+ coroutine, rather than taking its line number, so a coroutine saved
+ in a snapshot resumes at the same point in any build that keeps the
+ numbers.
+
+ What a coroutine waits for is up to the code that resumes it; the
+ routers' (router.c) wait for a timer, or for their router to signal a
+ change.
+**********************************************************************/
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+/* what a coroutine is waiting for */
+enum {
+  CO_RUNNING,          /* nothing: it is running, or has not started */
+  CO_TIME,             /* a timer */
+  CO_SIGNAL,           /* a nudge from the code it belongs with */
+  CO_DONE,             /* it ran off its end */
+};
+
+struct coroutine {
+  int resume;          /* point to carry on from, 0 to start at the top,
+                          -1 once done */
+  int waiting;         /* one of the above */
+};
+
+#define CO_INIT(co)     ((co)->resume = 0, (co)->waiting = CO_RUNNING)
+
+/* in a function returning void */
+#define CO_BEGIN(co)    switch ((co)->resume) { case 0:
+
+/* point: 1, 2, ... */
+#define CO_AWAIT(co, point, what)                                 \
+  do {                                                            \
+    (co)->waiting = (what);                                       \
+    (co)->resume = (point);                                       \
+    return;                                                       \
+  case (point):                                                   \
+    (co)->waiting = CO_RUNNING;                                   \
+  } while (0)
+
+#define CO_END(co)                                                \
+  }                                                               \
+  (co)->resume = -1;                                              \
+  (co)->waiting = CO_DONE
+
+#endif
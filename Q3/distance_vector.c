@@ -1,7 +1,27 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <unistd.h>
+#include <pthread.h>
 
-#define LINKCHANGES 1 
+#include "distance_vector.h"
+#include "evqueue.h"
+#include "router.h"
+#include "topology.h"
+#include "pool.h"
+#include "rng.h"
+#include "dvkernels.h"
+#include "trace.h"
+#include "scenario.h"
+#include "snapshot.h"
+#include "fib.h"
+#include "oracle.h"
+#include "sim.h"
+#include "twheel.h"
+
+#define LINKCHANGES 1
 /* ******************************************************************
 Programming assignment 3: implementing distributed, asynchronous,
                           distance vector routing.
@@ -11,32 +31,21 @@ THIS IS THE MAIN ROUTINE.  IT SHOULD NOT BE TOUCHED AT ALL BY STUDENTS!
 **********************************************************************/
 
 
-/* a rtpkt is the packet sent from one routing update process to
-   another via the call tolayer3() */
-struct rtpkt {
-  int sourceid;       /* id of sending router sending this pkt */
-  int destid;         /* id of router to which pkt being sent 
-                         (must be an immediate neighbor) */
-  int mincost[4];    /* min cost to node 0 ... 3 */
-  };
-
 int TRACE = 1;             /* for my debugging */
+int deltaupdates = 0;      /* -d */
 int YES = 1;
 int NO = 0;
 
-creatertpkt( initrtpkt, srcid, destid, mincosts)
-struct rtpkt *initrtpkt;
-int srcid;
-int destid;
-int mincosts[];
-
+/* the packet only refers to mincosts; tolayer2() takes its own copy.
+   It holds a full vector; a delta update sets dest and nentries after. */
+void creatertpkt(struct rtpkt *initrtpkt, int srcid, int destid, int *mincosts)
 {
-  int i;
   initrtpkt->sourceid = srcid;
   initrtpkt->destid = destid;
-  for (i=0; i<4; i++)
-    initrtpkt->mincost[i] = mincosts[i];
-}  
+  initrtpkt->mincost = mincosts;
+  initrtpkt->dest = NULL;
+  initrtpkt->nentries = nnodes;
+}
 
 
 /*****************************************************************
@@ -44,7 +53,7 @@ int mincosts[];
 The code below emulates the layer 2 and below network environment:
   - emulates the tranmission and delivery (with no loss and no
     corruption) between two physically connected nodes
-  - calls the initializations routines rtinit0, etc., once before
+  - calls the initialization routine rtinit once per node before
     beginning emulation
 
 THERE IS NOT REASON THAT ANY STUDENT SHOULD HAVE TO READ OR UNDERSTAND
@@ -54,224 +63,1822 @@ the emulator, you're welcome to look at the code - but again, you should have
 to, and you defeinitely should not have to modify
 ******************************************************************/
 
-struct event {
-   float evtime;           /* event time */
-   int evtype;             /* event type code */
-   int eventity;           /* entity where event occurs */
-   struct rtpkt *rtpktptr; /* ptr to packet (if any) assoc w/ this event */
-   struct event *prev;
-   struct event *next;
- };
-struct event *evlist = NULL;   /* the event list */
+const char *evqspec = "heap";    /* event list backend, see evqueue.h */
+
+/* a channel is one direction of a link.  The medium can not reorder, so
+   a packet may not arrive before the last packet sent on the same channel;
+   channels into the same node are independent of each other */
+struct channel {
+  float lastarrival;     /* arrival time of the newest packet sent on it */
+  uint64_t rng;          /* its own delay stream when lookahead > 0 */
+  unsigned long nsent;   /* packets sent on it so far */
+  /* the link it is a direction of, see transmit() */
+  float busyuntil;       /* when it is done sending what it was given */
+  int qhead, qlen;       /* with a bounded queue: its ring in sim->txq */
+  double busy;           /* time spent sending */
+  unsigned long bytes;   /* bytes sent */
+  unsigned long ndropped;  /* packets a full queue turned away */
+  unsigned long nlost;   /* packets sent but lost */
+};
+
+/* The nodes are split into nlps logical processes (lps) of consecutive
+   ids.  Each lp has its own event list, clock and event pool and only
+   ever runs the routers it owns, so with -j several lps are simulated at
+   once, one thread each.  Synchronization is conservative, in YAWNS
+   windows: every packet spends at least `lookahead` time units on the
+   wire, so if T is the earliest pending event anywhere, no lp can be sent
+   anything earlier than T+lookahead and all of them may run up to there
+   independently.  Packets for another lp wait in an outbox until the end
+   of the window, and events are returned to the pool they came from the
+   same way, so no locks are taken while a window runs.
+
+   With a lookahead, packet delays are drawn from a stream per channel and
+   ties are broken by channel and sequence number, so a run does not
+   depend on how the nodes are split: -j 1 and -j 8 produce the same
+   distance tables. */
+struct lp {
+  struct sim *sim;
+  int id;
+  struct evqueue *evlist;        /* the event list */
+  struct twheel wheel;           /* its routers' own timers */
+  struct pool evpool;            /* every struct event comes from here */
+  float clocktime;
+  struct event **outbox;         /* outbox[j]: sent to lp j this window */
+  struct event **returns;        /* returns[j]: lp j's events we freed */
+  float nexttime;                /* earliest pending event, end of window */
+  int phase;                     /* phase the clock is in, see below */
+  float *lastdelivery;           /* per phase, last packet delivered here */
+  float *lastchange;             /* per phase, last delivery here that
+                                    changed a route */
+  unsigned long *phasedelivered; /* per phase, packets delivered here */
+  unsigned long ndelivered;
+  unsigned long nentries;        /* cost entries in the packets sent */
+  int peakdepth;                 /* most events ever in evlist */
+  struct tracebuf trace;         /* -B: binary trace records */
+  pthread_t thread;
+};
+
+/* Everything one run of the simulation changes.  Runs share only the
+   topology and the settings, so several can go on at once (-b). */
+struct sim {
+  uint64_t seed;
+  uint64_t rng[4];               /* jimsrand()'s stream */
+  struct router *routers;        /* one routing process per node */
+  struct channel *channels;      /* one per topology edge */
+  float *txq;                    /* when each packet queued for a link with
+                                    a bounded queue is sent ... */
+  long *txqat;                   /* ... channel e's from txq[txqat[e]] */
+  int nlps;
+  struct lp *lps;
+  pthread_barrier_t windowbarrier;
+  float until;                   /* sim_rununtil(): stop before this time */
+  unsigned long nlinkchanges;
+  unsigned long *ntimers;        /* per node, timers started */
+  unsigned long *nsent;          /* per node, packets sent */
+  /* a run is divided into phases by the times at which link costs
+     change; a phase has converged once its last packet is delivered,
+     or with periodic updates, which never stop, the last one that
+     changed a route */
+  int nphases;
+  float *phasestart;             /* ascending, phasestart[0] = 0 */
+};
+
+static __thread struct sim *cursim;  /* the run this thread works on */
+static __thread struct lp *curlp;    /* the lp this thread is running */
+
+int nlps = 1;                    /* -j */
+float lookahead = 0.0;           /* -L: minimum delay of every link */
+uint64_t seed = 9999;            /* -s */
+int nruns = 0;                   /* -b: runs in a batch, 0 for one run */
+int nworkers = 0;                /* -w: threads running a batch */
+
+#define LPOF(sim, node)  ((int)((long long)(node) * (sim)->nlps / nnodes))
+
+/* the timing wheel's ticks per time unit; a router's own timer goes off
+   at the first tick at or after the time it asked for */
+#define WHEELHZ  64.0
+#define TICKTIME(tick)  ((float)((double)(tick) / WHEELHZ))
+
+int nnodes;                      /* number of nodes in the network */
+struct topology *topo;           /* who is connected to whom, at what cost */
+const char *topofile = NULL;     /* -t, else the assignment's network */
+const char *reportfile = NULL;   /* -r: JSON, or CSV if it ends in .csv */
+const char *tracefile = NULL;    /* -B: binary trace, see trace.h */
+
+struct scenario *scenario;       /* link cost changes to make */
+const char *scenariofile = NULL; /* -S, else the assignment's changes */
+
+const char *snapfile = NULL;     /* -C: checkpoint to write */
+float snaptime = -1.0;           /* -c: when, else before the first change */
+void *restoremap;                /* -R: the snapshot runs start from */
+size_t restoresize;
+
+const char *fibfile = NULL;      /* -F: the FIBs at the end of the run */
+long dppackets = 0;              /* -P: data plane packets per look */
+float dpinterval = 0.5;          /* -i: time between looks */
+
+int validate = 0;                /* -V: check the tables at the end */
+
+float stoptime = FLT_MAX;        /* -e: no run goes past this time */
+
+/* event handlers, indexed by evtype */
+static void fromlayer2(struct event *eventptr)
+{
+  struct sim *sim = cursim;
+  struct router *r = &sim->routers[eventptr->eventity];
+  unsigned long nchanged = r->nchanged;
+
+  while (curlp->phase + 1 < sim->nphases &&
+         sim->phasestart[curlp->phase + 1] <= eventptr->evtime)
+    curlp->phase++;
+  curlp->lastdelivery[curlp->phase] = eventptr->evtime;
+  curlp->phasedelivered[curlp->phase]++;
+  curlp->ndelivered++;
+  rtupdate(r, &eventptr->pkt);
+  if (r->nchanged != nchanged)
+    curlp->lastchange[curlp->phase] = eventptr->evtime;
+}
+
+static void linkchange(struct event *eventptr)
+{
+  linkhandler(&cursim->routers[eventptr->eventity], eventptr->linkid,
+              eventptr->linkcost);
+}
+
+static void routertimer(struct event *eventptr)
+{
+  rttimer(&cursim->routers[eventptr->eventity], eventptr->linkid);
+}
+
+static void (*const handlers[])(struct event *) = {
+  [FROM_LAYER2] = fromlayer2,
+  [LINK_CHANGE] = linkchange,
+  [ROUTER_TIMER] = routertimer,
+};
+#define NHANDLERS ((int)(sizeof(handlers) / sizeof(handlers[0])))
 
-/* possible events: */
-#define  FROM_LAYER2     2
-#define  LINK_CHANGE     10
 
-float clocktime = 0.000;
+/* the binary trace's record of an event about to be handled */
+static void traceevent(struct event *eventptr)
+{
+   struct tracerec *t = trace_next(&curlp->trace);
+
+   t->time = eventptr->evtime;
+   t->arrival = eventptr->evtime;
+   t->lp = curlp->id;
+   t->node = eventptr->eventity;
+   t->peer = eventptr->linkid;
+   t->value = 0;
+   switch (eventptr->evtype) {
+     case FROM_LAYER2:
+       t->type = TR_RECV;
+       t->peer = eventptr->pkt.sourceid;
+       t->value = eventptr->pkt.nentries;
+       break;
+     case LINK_CHANGE:
+       t->type = TR_LINK;
+       t->value = eventptr->linkcost;
+       break;
+     default:
+       t->type = TR_TIMER;
+       break;
+     }
+}
+
+/* the timers of curlp's wheel due at tick; they go off before the
+   events due at the same time */
+static void firetimers(uint64_t tick)
+{
+   struct wtimer *fired, *t;
+   struct tracerec *rec;
 
+   curlp->clocktime = TICKTIME(tick);
+   fired = wheel_expire(&curlp->wheel, tick);
+   while ((t = wheel_take(&fired)) != NULL) {
+     if (TRACE>1)
+       printf("MAIN: timer, t=%.3f, at %d, arg %d\n", curlp->clocktime,
+              t->node, t->arg);
+     if (curlp->trace.rec != NULL) {
+       rec = trace_next(&curlp->trace);
+       rec->type = TR_TIMER;
+       rec->time = rec->arrival = curlp->clocktime;
+       rec->lp = curlp->id;
+       rec->node = t->node;
+       rec->peer = t->arg;
+       rec->value = 0;
+       }
+     rttimer(&cursim->routers[t->node], t->arg);
+     }
+}
+
+/* time of lp's next event or timer, FLT_MAX if there is none */
+static float lpnext(struct lp *lp)
+{
+   struct event *p = evq_peek(lp->evlist);
+   uint64_t tick = wheel_next(&lp->wheel);
+   float t = p != NULL ? p->evtime : FLT_MAX;
+
+   if (tick != UINT64_MAX && TICKTIME(tick) <= t)
+     t = TICKTIME(tick);
+   return t;
+}
 
-main()
+/* run the events of curlp that happen before time until */
+static void simulate(float until)
 {
    struct event *eventptr;
-   
-   init();
-   
+   uint64_t tick;
+   int i;
+
    while (1) {
-     
-        eventptr = evlist;            /* get next event to simulate */
-        if (eventptr==NULL)
-           goto terminate;
-        evlist = evlist->next;        /* remove this event from event list */
-        if (evlist!=NULL)
-           evlist->prev=NULL;
+
+        eventptr = evq_peek(curlp->evlist);   /* get next event to simulate */
+        tick = wheel_next(&curlp->wheel);
+        if (tick != UINT64_MAX && TICKTIME(tick) < until &&
+            (eventptr == NULL || TICKTIME(tick) <= eventptr->evtime)) {
+          firetimers(tick);
+          continue;
+          }
+        if (eventptr==NULL || eventptr->evtime >= until)
+           return;
+        evq_pop(curlp->evlist);       /* remove this event from event list */
         if (TRACE>1) {
           printf("MAIN: rcv event, t=%.3f, at %d",
                           eventptr->evtime,eventptr->eventity);
           if (eventptr->evtype == FROM_LAYER2 ) {
-	    printf(" src:%2d,",eventptr->rtpktptr->sourceid);
-            printf(" dest:%2d,",eventptr->rtpktptr->destid);
-            printf(" contents: %3d %3d %3d %3d\n", 
-              eventptr->rtpktptr->mincost[0], eventptr->rtpktptr->mincost[1],
-              eventptr->rtpktptr->mincost[2], eventptr->rtpktptr->mincost[3]);
+	    printf(" src:%2d,",eventptr->pkt.sourceid);
+            printf(" dest:%2d,",eventptr->pkt.destid);
+            printf(" contents:");
+            for (i=0; i<eventptr->pkt.nentries; i++)
+              if (eventptr->pkt.dest != NULL)
+                printf(" %d:%d", eventptr->pkt.dest[i],
+                       eventptr->pkt.mincost[i]);
+              else
+                printf(" %3d", eventptr->pkt.mincost[i]);
             }
+          printf("\n");
           }
-        clocktime = eventptr->evtime;    /* update time to next event time */
-        if (eventptr->evtype == FROM_LAYER2 ) {
-            if (eventptr->eventity == 0) 
-	      rtupdate0(eventptr->rtpktptr);
-	     else if (eventptr->eventity == 1) 
-	      rtupdate1(eventptr->rtpktptr);
-	     else if (eventptr->eventity == 2) 
-	      rtupdate2(eventptr->rtpktptr);
-	     else if (eventptr->eventity == 3) 
-	      rtupdate3(eventptr->rtpktptr);
-             else { printf("Panic: unknown event entity\n"); exit(0); }
-	  }
-        else if (eventptr->evtype == LINK_CHANGE ) {
-            if (clocktime<10001.0) {
-	      linkhandler0(1,20);
-	      linkhandler1(0,20);
-              }
-	    else   {
-    	      linkhandler0(1,1);
-	      linkhandler1(0,1);
-              }
-	  }
-          else
-             { printf("Panic: unknown event type\n"); exit(0); }
-        if (eventptr->evtype == FROM_LAYER2 ) 
-          free(eventptr->rtpktptr);        /* free memory for packet, if any */
-        free(eventptr);                    /* free memory for event struct   */
+        curlp->clocktime = eventptr->evtime;  /* update time to next event time */
+        if (eventptr->evtype < 0 || eventptr->evtype >= NHANDLERS ||
+            handlers[eventptr->evtype] == NULL)
+          { printf("Panic: unknown event type\n"); exit(0); }
+        if (eventptr->eventity < 0 || eventptr->eventity >= nnodes)
+          { printf("Panic: unknown event entity\n"); exit(0); }
+        if (curlp->trace.rec != NULL)
+          traceevent(eventptr);
+        handlers[eventptr->evtype](eventptr);
+        freeevent(eventptr);     /* recycle event and the packet in it */
       }
-   
+}
+
+/* one thread per lp when running in parallel */
+static void *lpmain(void *arg)
+{
+   struct lp *lp = arg;
+   struct sim *sim = lp->sim;
+   struct event *p, *next;
+   float t;
+   int j;
+
+   cursim = sim;
+   curlp = lp;
+   while (1) {
+     pthread_barrier_wait(&sim->windowbarrier);
+     /* take what the other lps sent us during the window that just ended */
+     for (j=0; j<sim->nlps; j++) {
+       for (p = sim->lps[j].outbox[lp->id]; p != NULL; p = next) {
+         next = p->next;
+         evq_insertkeyed(lp->evlist, p);
+         }
+       sim->lps[j].outbox[lp->id] = NULL;
+       for (p = sim->lps[j].returns[lp->id]; p != NULL; p = next) {
+         next = p->next;
+         pool_put(&lp->evpool, p);
+         }
+       sim->lps[j].returns[lp->id] = NULL;
+       }
+     if (evq_size(lp->evlist) > lp->peakdepth)
+       lp->peakdepth = evq_size(lp->evlist);
+     lp->nexttime = lpnext(lp);
+     pthread_barrier_wait(&sim->windowbarrier);
+     t = FLT_MAX;
+     for (j=0; j<sim->nlps; j++)
+       if (sim->lps[j].nexttime < t)
+         t = sim->lps[j].nexttime;
+     if (t == FLT_MAX || t >= sim->until)
+       return NULL;
+     simulate(t + lookahead < sim->until ? t + lookahead : sim->until);
+     }
+}
+
+unsigned long sim_events(struct sim *sim)
+{
+   unsigned long n = 0;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     n += sim->lps[i].evpool.allocs;
+   return n;
+}
+
+unsigned long sim_pending(struct sim *sim)
+{
+   unsigned long n = 0;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     n += evq_size(sim->lps[i].evlist);
+   return n;
+}
+
+float sim_time(struct sim *sim)
+{
+   float t = 0.0;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     if (sim->lps[i].clocktime > t)
+       t = sim->lps[i].clocktime;
+   return t;
+}
+
+void sim_enter(struct sim *sim, int node)
+{
+   cursim = sim;
+   curlp = &sim->lps[LPOF(sim, node)];
+}
+
+struct router *sim_router(struct sim *sim, int node)
+{
+   return &sim->routers[node];
+}
+
+struct event *sim_popevent(struct sim *sim)
+{
+   (void)sim;
+   return evq_pop(curlp->evlist);
+}
+
+/* run the events before time until, or before stoptime; the run can be
+   taken up again from there, by sim_run() or another sim_rununtil() */
+void sim_rununtil(struct sim *sim, float until)
+{
+   int i;
+
+   if (until > stoptime)
+     until = stoptime;
+   cursim = sim;
+   sim->until = until;
+   if (sim->nlps == 1) {
+     curlp = &sim->lps[0];
+     simulate(until);
+     return;
+     }
+   pthread_barrier_init(&sim->windowbarrier, NULL, sim->nlps);
+   for (i=0; i<sim->nlps; i++)
+     pthread_create(&sim->lps[i].thread, NULL, lpmain, &sim->lps[i]);
+   for (i=0; i<sim->nlps; i++)
+     pthread_join(sim->lps[i].thread, NULL);
+   pthread_barrier_destroy(&sim->windowbarrier);
+}
+
+void sim_run(struct sim *sim)
+{
+   sim_rununtil(sim, FLT_MAX);
+}
+
+#ifndef DV_NOMAIN
+/* packets delivered during phase k */
+static unsigned long phasepackets(struct sim *sim, int k)
+{
+   unsigned long n = 0;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     n += sim->lps[i].phasedelivered[k];
+   return n;
+}
+
+/* time from the start of phase k to its last packet delivery, or with
+   periodic updates to the last delivery that changed a route */
+static float convergence(struct sim *sim, int k)
+{
+   float last = sim->phasestart[k], *t;
+   int i;
+
+   for (i=0; i<sim->nlps; i++) {
+     t = advertise > 0.0 ? sim->lps[i].lastchange : sim->lps[i].lastdelivery;
+     if (t[k] > last)
+       last = t[k];
+     }
+   return last - sim->phasestart[k];
+}
+
+static unsigned long delivered(struct sim *sim)
+{
+   unsigned long n = 0;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     n += sim->lps[i].ndelivered;
+   return n;
+}
+
+static unsigned long entriessent(struct sim *sim)
+{
+   unsigned long n = 0;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     n += sim->lps[i].nentries;
+   return n;
+}
+
+/* a fingerprint of every distance table, to compare runs by: each
+   router's best costs, then its neighbors' columns */
+static unsigned long long tablesdigest(struct sim *sim)
+{
+   unsigned long long h = 14695981039346656037ULL;
+   struct router *r;
+   int i, j, k;
+
+   for (i=0; i<nnodes; i++) {
+     r = &sim->routers[i];
+     for (j=0; j<nnodes; j++) {
+       h ^= (unsigned)r->best[j];
+       h *= 1099511628211ULL;
+       }
+     for (k=0; k<r->nneighbors; k++)
+       for (j=0; j<nnodes; j++)
+         if (j != r->neighbors[k]) {
+           h ^= (unsigned)DT(r, j, k);
+           h *= 1099511628211ULL;
+           }
+     }
+   return h;
+}
+
+/* -W: what holding the routers' updates for a window saved, and what it
+   cost them in time */
+struct coalescing {
+   unsigned long nheld, nwindows, nsaved;
+   double meanheld;               /* time a vector change waited on
+                                     average */
+};
+
+static void coalescing(struct sim *sim, struct coalescing *c)
+{
+   double heldfor = 0.0;
+   int i;
+
+   memset(c, 0, sizeof *c);
+   for (i=0; i<nnodes; i++) {
+     c->nheld += sim->routers[i].nheld;
+     c->nwindows += sim->routers[i].nwindows;
+     c->nsaved += sim->routers[i].nsaved;
+     heldfor += sim->routers[i].heldfor;
+     }
+   if (c->nheld > 0)
+     c->meanheld = heldfor / c->nheld;
+}
+
+/* what the links with attributes (topology.h) carried: totals over the
+   channels, and the busiest one's share of the run spent sending */
+struct linkload {
+   unsigned long bytes, ndropped, nlost;
+   double meanutil, maxutil;
+   int busiest, busiestfrom;      /* its edge, -1 if none was busy, and
+                                     the node it starts at */
+};
+
+static double utilization(const struct channel *ch, float endtime)
+{
+   return endtime > 0.0 ? ch->busy / endtime : 0.0;
+}
+
+static void linkload(struct sim *sim, float endtime, struct linkload *l)
+{
+   double u;
+   int i, e;
+
+   memset(l, 0, sizeof *l);
+   l->busiest = -1;
+   for (i=0; i<nnodes; i++)
+    for (e=topo->rowstart[i]; e<topo->rowstart[i+1]; e++) {
+     l->bytes += sim->channels[e].bytes;
+     l->ndropped += sim->channels[e].ndropped;
+     l->nlost += sim->channels[e].nlost;
+     u = utilization(&sim->channels[e], endtime);
+     l->meanutil += u;
+     if (u > l->maxutil) {
+       l->maxutil = u;
+       l->busiest = e;
+       l->busiestfrom = i;
+       }
+     }
+   if (topo->nedges > 0)
+     l->meanutil /= topo->nedges;
+}
+
+/* the end of run summary, for scripts: JSON, or CSV as one
+   section,id,metric,value line per number */
+static void writereport(struct sim *sim, const char *path, float endtime)
+{
+   static const char *policies[] = { "legacy", "bf", "poison" };
+   const char *dot = strrchr(path, '.');
+   int csv = dot != NULL && strcmp(dot, ".csv") == 0;
+   struct channel *ch;
+   struct coalescing co;
+   int i, k, e, depth;
+   FILE *f;
+
+   f = fopen(path, "w");
+   if (f == NULL) {
+     perror(path);
+     return;
+     }
+   depth = 0;
+   for (i=0; i<sim->nlps; i++)
+     depth += sim->lps[i].peakdepth;
+   coalescing(sim, &co);
+   if (csv) {
+     fprintf(f, "section,id,metric,value\n");
+     fprintf(f, "run,,seed,%llu\n", (unsigned long long)sim->seed);
+     fprintf(f, "run,,nodes,%d\n", nnodes);
+     fprintf(f, "run,,policy,%s\n", policies[rtpolicy]);
+     fprintf(f, "run,,delta_updates,%d\n", deltaupdates);
+     fprintf(f, "run,,end_time,%.3f\n", endtime);
+     fprintf(f, "run,,packets,%lu\n", delivered(sim));
+     fprintf(f, "run,,entries_sent,%lu\n", entriessent(sim));
+     fprintf(f, "run,,peak_event_list_depth,%d\n", depth);
+     fprintf(f, "run,,digest,%016llx\n", tablesdigest(sim));
+     if (coalesce > 0.0) {
+       fprintf(f, "run,,coalesce_window,%.3f\n", coalesce);
+       fprintf(f, "run,,vector_changes_held,%lu\n", co.nheld);
+       fprintf(f, "run,,coalesced_updates,%lu\n", co.nwindows);
+       fprintf(f, "run,,packets_saved,%lu\n", co.nsaved);
+       fprintf(f, "run,,mean_hold,%.3f\n", co.meanheld);
+       }
+     for (k=0; k<sim->nphases; k++) {
+       fprintf(f, "phase,%d,start,%.3f\n", k, sim->phasestart[k]);
+       fprintf(f, "phase,%d,quiescence,%.3f\n", k, convergence(sim, k));
+       fprintf(f, "phase,%d,packets,%lu\n", k, phasepackets(sim, k));
+       }
+     for (i=0; i<nnodes; i++) {
+       fprintf(f, "router,%d,packets_sent,%lu\n", i, sim->nsent[i]);
+       fprintf(f, "router,%d,entries_changed,%lu\n", i,
+               sim->routers[i].nchanged);
+       }
+     for (i=0; topo->link != NULL && i<nnodes; i++)
+      for (e=topo->rowstart[i]; e<topo->rowstart[i+1]; e++) {
+       ch = &sim->channels[e];
+       fprintf(f, "link,%d-%d,bytes,%lu\n", i, topo->adj[e], ch->bytes);
+       fprintf(f, "link,%d-%d,utilization,%.4f\n", i, topo->adj[e],
+               utilization(ch, endtime));
+       fprintf(f, "link,%d-%d,dropped,%lu\n", i, topo->adj[e],
+               ch->ndropped);
+       fprintf(f, "link,%d-%d,lost,%lu\n", i, topo->adj[e], ch->nlost);
+       }
+     }
+   else {
+     fprintf(f, "{\n  \"seed\": %llu,\n", (unsigned long long)sim->seed);
+     fprintf(f, "  \"nodes\": %d,\n", nnodes);
+     fprintf(f, "  \"policy\": \"%s\",\n", policies[rtpolicy]);
+     fprintf(f, "  \"delta_updates\": %s,\n", deltaupdates ? "true" : "false");
+     fprintf(f, "  \"end_time\": %.3f,\n", endtime);
+     fprintf(f, "  \"packets\": %lu,\n", delivered(sim));
+     fprintf(f, "  \"entries_sent\": %lu,\n", entriessent(sim));
+     fprintf(f, "  \"peak_event_list_depth\": %d,\n", depth);
+     fprintf(f, "  \"digest\": \"%016llx\",\n", tablesdigest(sim));
+     if (coalesce > 0.0)
+       fprintf(f, "  \"coalescing\": { \"window\": %.3f, "
+               "\"vector_changes_held\": %lu, \"updates\": %lu, "
+               "\"packets_saved\": %lu, \"mean_hold\": %.3f },\n",
+               coalesce, co.nheld, co.nwindows, co.nsaved, co.meanheld);
+     fprintf(f, "  \"phases\": [\n");
+     for (k=0; k<sim->nphases; k++)
+       fprintf(f, "    { \"start\": %.3f, \"quiescence\": %.3f, "
+               "\"packets\": %lu }%s\n", sim->phasestart[k],
+               convergence(sim, k), phasepackets(sim, k),
+               k + 1 < sim->nphases ? "," : "");
+     fprintf(f, "  ],\n  \"routers\": [\n");
+     for (i=0; i<nnodes; i++)
+       fprintf(f, "    { \"id\": %d, \"packets_sent\": %lu, "
+               "\"entries_changed\": %lu }%s\n", i, sim->nsent[i],
+               sim->routers[i].nchanged, i + 1 < nnodes ? "," : "");
+     if (topo->link != NULL) {
+       fprintf(f, "  ],\n  \"links\": [\n");
+       for (i=0; i<nnodes; i++)
+        for (e=topo->rowstart[i]; e<topo->rowstart[i+1]; e++) {
+         ch = &sim->channels[e];
+         fprintf(f, "    { \"from\": %d, \"to\": %d, \"bytes\": %lu, "
+                 "\"utilization\": %.4f, \"dropped\": %lu, "
+                 "\"lost\": %lu }%s\n", i, topo->adj[e],
+                 ch->bytes, utilization(ch, endtime), ch->ndropped,
+                 ch->nlost, e + 1 < topo->nedges ? "," : "");
+         }
+       }
+     fprintf(f, "  ]\n}\n");
+     }
+   fclose(f);
+}
+
+static void report(struct sim *sim)
+{
+   unsigned long allocs, heapallocs, pending, expired;
+   struct linkload load;
+   struct coalescing co;
+   long peak;
+   float endtime;
+   int i, k;
+
+   endtime = 0.0;
+   allocs = heapallocs = pending = 0;
+   peak = 0;
+   for (i=0; i<sim->nlps; i++) {
+     if (sim->lps[i].clocktime > endtime)
+       endtime = sim->lps[i].clocktime;
+     allocs += sim->lps[i].evpool.allocs;
+     heapallocs += sim->lps[i].evpool.heapallocs;
+     peak += sim->lps[i].evpool.peak;
+     pending += evq_size(sim->lps[i].evlist) + sim->lps[i].wheel.count;
+     }
+   if (pending == 0)
+     printf("\nSimulator terminated at t=%f, no packets in medium\n", endtime);
+   else
+     printf("\nSimulator stopped at t=%f, %lu events pending\n", endtime,
+            pending);
+   printf("%lu events used %lu heap allocations, at most %ld pending\n",
+          allocs, heapallocs, peak);
+   for (k=0; k<sim->nphases; k++)
+     printf("converged %.3f after t=%.3f, %lu packets\n",
+            convergence(sim, k), sim->phasestart[k], phasepackets(sim, k));
+   printf("%lu packets delivered, carrying %lu cost entries\n",
+          delivered(sim), entriessent(sim));
+   if (routetimeout > 0.0) {
+     for (expired=0, i=0; i<nnodes; i++)
+       expired += sim->routers[i].nexpired;
+     printf("%lu routes timed out\n", expired);
+     }
+   if (coalesce > 0.0) {
+     coalescing(sim, &co);
+     printf("%lu vector changes went out in %lu coalesced updates, "
+            "about %lu packets saved;\neach vector change waited %.3f on "
+            "average before it was sent\n", co.nheld, co.nwindows,
+            co.nsaved, co.meanheld);
+     }
+   if (topo->link != NULL) {
+     linkload(sim, endtime, &load);
+     printf("%lu bytes sent, links busy %.1f%% of the time on average",
+            load.bytes, 100.0 * load.meanutil);
+     if (load.busiest >= 0)
+       printf(", at most %.1f%% (%d-%d)", 100.0 * load.maxutil,
+              load.busiestfrom, topo->adj[load.busiest]);
+     printf("\n%lu packets dropped by full queues, %lu lost\n",
+            load.ndropped, load.nlost);
+     }
+   printf("distance tables digest %016llx\n", tablesdigest(sim));
+   if (reportfile != NULL)
+     writereport(sim, reportfile, endtime);
+}
+
+/************************* BATCH OF RUNS *************************/
+/* -b runs the simulation once for each of the seeds seed .. seed+runs-1,
+   on -w threads, and summarizes the spread of the results. */
+
+/* a run from the start, or with -R from the snapshot */
+static struct sim *newsim(uint64_t simseed)
+{
+   if (restoremap != NULL)
+     return sim_restore(restoremap, restoresize, simseed);
+   return sim_create(simseed);
+}
+
+struct batch {
+  int next;                      /* next run to hand out */
+  pthread_mutex_t lock;
+  int nphases;
+  float *phasestart;
+  float *conv;                   /* conv[run*nphases+k] */
+  double *phasepkts;             /* phasepkts[run*nphases+k] */
+  double *packets;               /* per run */
+  double *entries;               /* per run */
+};
+
+static void *batchworker(void *arg)
+{
+   struct batch *b = arg;
+   struct sim *sim;
+   int run, k;
+
+   while (1) {
+     pthread_mutex_lock(&b->lock);
+     run = b->next++;
+     pthread_mutex_unlock(&b->lock);
+     if (run >= nruns)
+       return NULL;
+     sim = newsim(seed + run);
+     sim_run(sim);
+     for (k=0; k<b->nphases && k<sim->nphases; k++) {
+       b->conv[run * b->nphases + k] = convergence(sim, k);
+       b->phasepkts[run * b->nphases + k] = phasepackets(sim, k);
+       }
+     b->packets[run] = delivered(sim);
+     b->entries[run] = entriessent(sim);
+     sim_destroy(sim);
+     }
+}
+
+static int cmpdouble(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+
+   return (x > y) - (x < y);
+}
+
+/* min, p50, p90, p99 and max of n values, nearest rank */
+static void printpercentiles(const char *label, double *v, int n)
+{
+   static const double pct[] = { 50.0, 90.0, 99.0 };
+   int i, rank;
+
+   qsort(v, n, sizeof(double), cmpdouble);
+   printf("%-24s %10.3f", label, v[0]);
+   for (i=0; i<3; i++) {
+     rank = (int)(pct[i] / 100.0 * n + 0.999999);
+     if (rank < 1)
+       rank = 1;
+     printf(" %10.3f", v[rank - 1]);
+     }
+   printf(" %10.3f\n", v[n - 1]);
+}
+
+static void runbatch()
+{
+   struct batch b;
+   struct sim *sim;
+   pthread_t *threads;
+   double *v;
+   char label[64];
+   int i, k;
+
+   /* the phases are the same in every run; take them from a dry one */
+   sim = newsim(seed);
+   b.nphases = sim->nphases;
+   b.phasestart = (float *)malloc(b.nphases * sizeof(float));
+   for (k=0; k<b.nphases; k++)
+     b.phasestart[k] = sim->phasestart[k];
+   sim_destroy(sim);
+
+   b.next = 0;
+   pthread_mutex_init(&b.lock, NULL);
+   b.conv = (float *)calloc((size_t)nruns * b.nphases, sizeof(float));
+   b.phasepkts = (double *)calloc((size_t)nruns * b.nphases, sizeof(double));
+   b.packets = (double *)calloc(nruns, sizeof(double));
+   b.entries = (double *)calloc(nruns, sizeof(double));
+   threads = (pthread_t *)malloc(nworkers * sizeof(pthread_t));
+   for (i=0; i<nworkers; i++)
+     pthread_create(&threads[i], NULL, batchworker, &b);
+   for (i=0; i<nworkers; i++)
+     pthread_join(threads[i], NULL);
+
+   printf("%d runs, seeds %llu..%llu, %d threads\n", nruns,
+          (unsigned long long)seed, (unsigned long long)(seed + nruns - 1),
+          nworkers);
+   printf("%-24s %10s %10s %10s %10s %10s\n", "", "min", "p50", "p90", "p99",
+          "max");
+   v = (double *)malloc(nruns * sizeof(double));
+   for (k=0; k<b.nphases; k++) {
+     for (i=0; i<nruns; i++)
+       v[i] = b.conv[i * b.nphases + k];
+     snprintf(label, sizeof(label), "converge after t=%.0f", b.phasestart[k]);
+     printpercentiles(label, v, nruns);
+     for (i=0; i<nruns; i++)
+       v[i] = b.phasepkts[i * b.nphases + k];
+     snprintf(label, sizeof(label), "packets after t=%.0f", b.phasestart[k]);
+     printpercentiles(label, v, nruns);
+     }
+   printpercentiles("packets delivered", b.packets, nruns);
+   printpercentiles("cost entries sent", b.entries, nruns);
+   free(v);
+   free(threads);
+   free(b.conv);
+   free(b.phasepkts);
+   free(b.packets);
+   free(b.entries);
+   free(b.phasestart);
+   pthread_mutex_destroy(&b.lock);
+}
+
+/* the network the assignment is set on */
+static const int defaultlinks[][3] = {
+  { 0, 1, 1 }, { 0, 2, 3 }, { 0, 3, 7 }, { 1, 2, 1 }, { 2, 3, 2 },
+};
+
+/* and the changes made to it */
+static const struct linkchange defaultchanges[] = {
+  { 10000.0, 0, 1, 20 }, { 20000.0, 0, 1, 1 },
+};
+
+/************************** DATA PLANE ***************************/
+/* -P n sends n packets through the routers' FIBs (see fib.h) once the
+   network has settled after the start, and after every link change
+   every -i time units until it has settled again, which is when packets
+   can loop.  -F writes the FIBs as they are at the end of the run. */
+
+static void compilefibs(struct sim *sim, struct fib *f)
+{
+   int i;
+
+   for (i=0; i<nnodes; i++) {
+     rtfib(&sim->routers[i], &f->e[(size_t)i * nnodes]);
+     memcpy(&f->linkcost[topo->rowstart[i]], sim->routers[i].linkcosts,
+            sim->routers[i].nneighbors * sizeof(int));
+     }
+}
+
+/* time of the earliest pending event or timer, FLT_MAX if there is none */
+static float nextevent(struct sim *sim)
+{
+   float t = FLT_MAX;
+   int i;
+
+   for (i=0; i<sim->nlps; i++)
+     if (lpnext(&sim->lps[i]) < t)
+       t = lpnext(&sim->lps[i]);
+   return t;
+}
+
+static void printdpstats(const char *label, int nlooks, struct dpstats *st)
+{
+   double n = st->packets ? (double)st->packets : 1.0;
+
+   printf("%s: %d looks, %.2f%% delivered, %.2f%% looped, %.2f%% dropped, "
+          "stretch %.3f mean %.3f max, %.2f%% stretched\n", label, nlooks,
+          100.0 * st->delivered / n, 100.0 * st->looped / n,
+          100.0 * st->dropped / n,
+          st->delivered ? st->stretch / st->delivered : 0.0, st->maxstretch,
+          100.0 * st->stretched / (st->delivered ? st->delivered : 1));
+}
 
-terminate:
-   printf("\nSimulator terminated at t=%f, no packets in medium\n", clocktime);
+static void addstats(struct dpstats *sum, const struct dpstats *st)
+{
+   sum->packets += st->packets;
+   sum->delivered += st->delivered;
+   sum->looped += st->looped;
+   sum->dropped += st->dropped;
+   sum->hops += st->hops;
+   sum->stretched += st->stretched;
+   sum->stretch += st->stretch;
+   if (st->maxstretch > sum->maxstretch)
+     sum->maxstretch = st->maxstretch;
+   sum->seconds += st->seconds;
+}
+
+static void dataplane(struct sim *sim)
+{
+   struct dpstats *st, changes, all;
+   struct fib *f;
+   uint64_t rng = seed ^ 0xd1b54a32d192ed03ULL;   /* not jimsrand()'s */
+   char label[64];
+   int *nlooks, k, j, nchangelooks;
+   float t, end;
+
+   f = fib_create(topo);
+   st = (struct dpstats *)calloc(sim->nphases, sizeof(struct dpstats));
+   nlooks = (int *)calloc(sim->nphases, sizeof(int));
+   if (f == NULL || st == NULL || nlooks == NULL) {
+     printf("Panic: out of memory for the data plane\n");
+     exit(1);
+     }
+   for (k=0; k<sim->nphases; k++) {
+     end = k + 1 < sim->nphases ? sim->phasestart[k + 1] : stoptime;
+     for (j=0; ; j++) {
+       /* the start is not a reconvergence: look once it is over */
+       if (k == 0)
+         sim_rununtil(sim, end);
+       else {
+         t = sim->phasestart[k] + j * dpinterval;
+         if (t >= end)
+           break;
+         sim_rununtil(sim, t + t * FLT_EPSILON);   /* t included */
+         }
+       compilefibs(sim, f);
+       fib_forward(f, dppackets, &rng, &st[k]);
+       nlooks[k]++;
+       if (k == 0 || nextevent(sim) >= end)     /* settled */
+         break;
+       }
+     }
+   sim_run(sim);
+
+   printf("\ndata plane, %ld packets per look at the FIBs:\n", dppackets);
+   memset(&changes, 0, sizeof(changes));
+   nchangelooks = 0;
+   for (k=0; k<sim->nphases; k++) {
+     snprintf(label, sizeof(label), "after t=%.3f", sim->phasestart[k]);
+     printdpstats(label, nlooks[k], &st[k]);
+     if (k > 0) {
+       addstats(&changes, &st[k]);
+       nchangelooks += nlooks[k];
+       }
+     }
+   if (sim->nphases > 2)
+     printdpstats("after every link change", nchangelooks, &changes);
+   all = st[0];
+   addstats(&all, &changes);
+   printf("forwarded %lu packets, %lu hops in %.3f s: %.2f Mpackets/s, "
+          "%.1f ns per hop\n", all.packets, all.hops, all.seconds,
+          all.seconds > 0.0 ? all.packets / all.seconds / 1e6 : 0.0,
+          all.hops ? 1e9 * all.seconds / all.hops : 0.0);
+   free(nlooks);
+   free(st);
+   fib_free(f);
+}
+
+static void writefibs(struct sim *sim)
+{
+   struct fib *f;
+   FILE *fp;
+
+   f = fib_create(topo);
+   fp = fopen(fibfile, "w");
+   if (f == NULL || fp == NULL) {
+     perror(fibfile);
+     exit(1);
+     }
+   compilefibs(sim, f);
+   fib_write(f, fp);
+   fclose(fp);
+   fib_free(f);
+}
+
+/**************************** VALIDATION *****************************/
+/* -V: once the run is over and the network quiet, every router's
+   minimum costs should be those of the cheapest paths over the links'
+   current costs.  oracle.h works those out, on -w threads. */
+
+static int checktables(struct sim *sim)
+{
+   struct oraclestats st;
+   int **best, *linkcost, i, nthreads;
+
+   best = (int **)malloc((nnodes ? nnodes : 1) * sizeof(int *));
+   linkcost = (int *)malloc((topo->nedges ? topo->nedges : 1) * sizeof(int));
+   if (best == NULL || linkcost == NULL) {
+     printf("Panic: out of memory for the oracle\n");
+     exit(1);
+     }
+   for (i=0; i<nnodes; i++) {
+     best[i] = sim->routers[i].best;
+     memcpy(&linkcost[topo->rowstart[i]], sim->routers[i].linkcosts,
+            sim->routers[i].nneighbors * sizeof(int));
+     }
+   nthreads = nworkers;
+   if (nthreads == 0)
+     nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   oracle_check(topo, linkcost, best, nthreads, &st);
+   if (st.router < 0)
+     printf("oracle: all %d routers have the cheapest paths (%.3f s on %d "
+            "threads)\n", nnodes, st.seconds, nthreads < 1 ? 1 : nthreads);
+   else {
+     printf("oracle: %ld costs wrong in %d of %d routers (%.3f s on %d "
+            "threads)\n", st.mismatches, st.routers, nnodes, st.seconds,
+            nthreads < 1 ? 1 : nthreads);
+     printf("oracle: first at router %d, destination %d: %d in the table, "
+            "%d by the cheapest path\n", st.router, st.dest, st.got, st.want);
+     if (rtpolicy == RT_LEGACY)
+       printf("oracle: -p legacy never raises a cost, so routes that got "
+              "worse stay wrong\n");
+     }
+   free(linkcost);
+   free(best);
+   return st.router < 0;
+}
+
+/* -C: run up to the checkpoint time and save the state there */
+static void checkpoint(struct sim *sim)
+{
+   float t = snaptime, clock = sim->lps[0].clocktime;
+   int i;
+
+   if (t < 0.0) {
+     t = FLT_MAX;
+     for (i=0; i<scenario->nchanges; i++)
+       if (scenario->changes[i].time > clock) {
+         t = scenario->changes[i].time;
+         break;
+         }
+     }
+   sim_rununtil(sim, t);
+   if (t == FLT_MAX)                /* no changes: once the network is quiet */
+     for (t=0.0, i=0; i<sim->nlps; i++)
+       if (sim->lps[i].clocktime > t)
+         t = sim->lps[i].clocktime;
+   if (!sim_save(sim, snapfile, t))
+     exit(1);
+   printf("checkpoint at t=%.3f written to %s\n", t, snapfile);
+}
+
+static void usage(const char *prog)
+{
+   printf("usage: %s [-q list|heap|dheap[:d]|calendar] [-t topology]\n"
+          "       [-L lookahead] [-j threads] [-s seed] [-T trace]\n"
+          "       [-b runs [-w threads]] [-k avx2|sse4.1|generic] [-d]\n"
+          "       [-p legacy|bf|poison] [-H holddown] [-r report.json|.csv]\n"
+          "       [-B binarytrace] [-S scenario] [-C snapshot [-c time]]\n"
+          "       [-R snapshot] [-F fibs] [-P packets [-i interval]] [-V]\n"
+          "       [-A period [-O timeout] -e endtime] [-W window]\n",
+          prog);
+   exit(1);
+}
+
+int main(int argc, char **argv)
+{
+   struct sim *sim;
+   const char *kernels = NULL, *restorefile = NULL;
+   int c, trace = -1, ok = 1;
+
+   while ((c = getopt(argc, argv, "q:t:L:j:s:T:b:w:k:dp:H:r:B:S:C:c:R:F:P:i:VA:O:e:W:")) != -1) {
+     switch (c) {
+       case 'q': evqspec = optarg; break;
+       case 't': topofile = optarg; break;
+       case 'L': lookahead = atof(optarg); break;
+       case 'j': nlps = atoi(optarg); break;
+       case 's': seed = strtoull(optarg, NULL, 0); break;
+       case 'T': trace = atoi(optarg); break;
+       case 'b': nruns = atoi(optarg); break;
+       case 'w': nworkers = atoi(optarg); break;
+       case 'k': kernels = optarg; break;
+       case 'd': deltaupdates = 1; break;
+       case 'p':
+         if (strcmp(optarg, "legacy") == 0) rtpolicy = RT_LEGACY;
+         else if (strcmp(optarg, "bf") == 0) rtpolicy = RT_BELLMANFORD;
+         else if (strcmp(optarg, "poison") == 0) rtpolicy = RT_POISON;
+         else usage(argv[0]);
+         break;
+       case 'H': holddown = atof(optarg); break;
+       case 'r': reportfile = optarg; break;
+       case 'B': tracefile = optarg; break;
+       case 'S': scenariofile = optarg; break;
+       case 'C': snapfile = optarg; break;
+       case 'c': snaptime = atof(optarg); break;
+       case 'R': restorefile = optarg; break;
+       case 'F': fibfile = optarg; break;
+       case 'P': dppackets = atol(optarg); break;
+       case 'i': dpinterval = atof(optarg); break;
+       case 'V': validate = 1; break;
+       case 'A': advertise = atof(optarg); break;
+       case 'O': routetimeout = atof(optarg); break;
+       case 'e': stoptime = atof(optarg); break;
+       case 'W': coalesce = atof(optarg); break;
+       default:  usage(argv[0]);
+       }
+     }
+   if (nlps < 1 || lookahead < 0.0 || nruns < 0 || nworkers < 0 ||
+       dppackets < 0 || dpinterval <= 0.0 || coalesce < 0.0)
+     usage(argv[0]);
+   if (nlps > 1 && lookahead <= 0.0) {
+     printf("running in parallel (-j) needs a positive lookahead (-L)\n");
+     usage(argv[0]);
+     }
+   if (advertise > 0.0 && stoptime == FLT_MAX) {
+     printf("periodic updates (-A) never stop, the run needs an end (-e)\n");
+     usage(argv[0]);
+     }
+   if (routetimeout > 0.0 && (advertise <= 0.0 || routetimeout <= advertise ||
+                              rtpolicy == RT_LEGACY)) {
+     printf("routes time out (-O) when periodic updates (-A) stop coming, "
+            "which takes a longer timeout and -p bf or poison\n");
+     usage(argv[0]);
+     }
+   if (holddown > 0.0 && rtpolicy == RT_LEGACY) {
+     printf("a hold-down (-H) needs costs that can go up, -p bf or poison\n");
+     usage(argv[0]);
+     }
+   if (nruns > 0 && (reportfile != NULL || tracefile != NULL)) {
+     printf("a batch (-b) writes no report (-r) or trace (-B) files\n");
+     usage(argv[0]);
+     }
+   if (nruns > 0 && (snapfile != NULL || fibfile != NULL || dppackets > 0 ||
+                     validate)) {
+     printf("a batch (-b) writes no checkpoint (-C) or FIBs (-F), sends "
+            "no packets (-P) and checks no tables (-V)\n");
+     usage(argv[0]);
+     }
+   if (snaptime >= 0.0 && snapfile == NULL)
+     usage(argv[0]);
+   if (nruns > 0 && nlps > 1) {
+     printf("a batch (-b) runs each simulation on one thread, drop -j\n");
+     usage(argv[0]);
+     }
+   if (!dvk_select(kernels)) {
+     printf("kernels '%s' are unknown or not supported by this CPU\n",
+            kernels);
+     usage(argv[0]);
+     }
+   if (topofile != NULL)
+     topo = topo_load(topofile);
+   else
+     topo = topo_fromedges(4, sizeof(defaultlinks) / sizeof(defaultlinks[0]),
+                           defaultlinks);
+   if (topo == NULL)
+     exit(1);
+   nnodes = topo->nnodes;
+   if (scenariofile != NULL)
+     scenario = scenario_load(scenariofile, topo);
+   else if (LINKCHANGES==1 && topofile==NULL)
+     scenario = scenario_fromchanges(sizeof(defaultchanges) /
+                                     sizeof(defaultchanges[0]),
+                                     defaultchanges);
+   else
+     scenario = scenario_fromchanges(0, NULL);
+   if (scenario == NULL)
+     exit(1);
+   if (nlps > nnodes)
+     nlps = nnodes;
+   if (restorefile != NULL &&
+       (restoremap = snap_open(restorefile, &restoresize)) == NULL)
+     exit(1);
+
+   if (nruns > 0) {                 /* batches never ask, and never trace */
+     TRACE = 0;
+     if (nworkers == 0)
+       nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+     if (nworkers < 1)
+       nworkers = 1;
+     runbatch();
+     scenario_free(scenario);
+     topo_free(topo);
+     return 0;
+     }
+
+   if (trace >= 0)
+     TRACE = trace;
+   else {
+     printf("Enter TRACE:");
+     scanf("%d",&TRACE);
+     }
+   if (nlps > 1 && TRACE > 0) {
+     printf("tracing is off when running in parallel\n");
+     TRACE = 0;
+     }
+
+   if (tracefile != NULL && !trace_open(tracefile, nnodes, nlps))
+     exit(1);
+   sim = newsim(seed);
+   if (snapfile != NULL)
+     checkpoint(sim);
+   if (dppackets > 0)
+     dataplane(sim);
+   else
+     sim_run(sim);
+   report(sim);
+   if (fibfile != NULL)
+     writefibs(sim);
+   if (validate)
+     ok = checktables(sim);
+   sim_destroy(sim);
+   trace_close();
+   if (restoremap != NULL)
+     snap_close(restoremap, restoresize);
+   scenario_free(scenario);
+   topo_free(topo);
+   return ok ? 0 : 1;
 }
+#endif /* DV_NOMAIN */
+
 
 
+/* schedule a change of the cost of a link; each end learns about it
+   through its own LINK_CHANGE event */
+static void schedulelinkchange(const struct linkchange *c)
+{
+  struct sim *sim = cursim;
+  struct event *evptr;
+  struct lp *lp;
+  int end;
+
+  /* keyed in every mode, since ties on evtime come out largest key
+     first: changes at the same time are applied in file order, and a
+     handles each before b does */
+  for (end = 0; end < 2; end++) {
+    lp = curlp = &sim->lps[LPOF(sim, end == 0 ? c->a : c->b)];
+    evptr = newevent();
+    evptr->evtime =  c->time;
+    evptr->evtype =  LINK_CHANGE;
+    evptr->eventity = end == 0 ? c->a : c->b;
+    evptr->linkid = end == 0 ? c->b : c->a;
+    evptr->linkcost = c->cost;
+    evptr->evseq = ~0UL - sim->nlinkchanges++;
+    evq_insertkeyed(lp->evlist, evptr);
+    if (evq_size(lp->evlist) > lp->peakdepth)
+      lp->peakdepth = evq_size(lp->evlist);
+    }
+}
 
-init()                         /* initialize the simulator */
+/* a run with its random streams seeded and nothing else set up yet */
+static struct sim *sim_alloc(uint64_t simseed)
 {
+  struct sim *sim;
+  uint64_t sm;
   int i;
   float sum, avg;
   float jimsrand();
-  struct event *evptr;  
-  
-   printf("Enter TRACE:");
-   scanf("%d",&TRACE);
 
-   srand(9999);              /* init random number generator */
+   sim = (struct sim *)calloc(1, sizeof(struct sim));
+   cursim = sim;
+   sim->seed = simseed;
+   sm = simseed;                 /* init random number generator */
+   for (i=0; i<4; i++)
+     sim->rng[i] = splitmix64(&sm);
    sum = 0.0;                /* test random number generator for students */
    for (i=0; i<1000; i++)
       sum=sum+jimsrand();    /* jimsrand() should be uniform in [0,1] */
    avg = sum/1000.0;
    if (avg < 0.25 || avg > 0.75) {
-    printf("It is likely that random number generation on your machine\n" ); 
+    printf("It is likely that random number generation on your machine\n" );
     printf("is different from what this emulator expects.  Please take\n");
     printf("a look at the routine jimsrand() in the emulator code. Sorry. \n");
     exit(0);
     }
 
-   clocktime=0.0;                /* initialize time to 0.0 */
-   rtinit0();
-   rtinit1();
-   rtinit2();
-   rtinit3();
+   sim->channels = (struct channel *)calloc(topo->nedges ? topo->nedges : 1,
+                                            sizeof(struct channel));
+   for (i=0; i<topo->nedges; i++)
+     sim->channels[i].rng = simseed ^
+                            (0x9e3779b97f4a7c15ULL * (uint64_t)(i + 1));
+   sim->txqat = (long *)calloc(topo->nedges + 1, sizeof(long));
+   for (i=0; i<topo->nedges; i++)
+     sim->txqat[i + 1] = sim->txqat[i] + topo_link(topo, i)->queue;
+   sim->txq = (float *)calloc(sim->txqat[topo->nedges] + 1, sizeof(float));
+   sim->routers = (struct router *)malloc(nnodes * sizeof(struct router));
+   sim->ntimers = (unsigned long *)calloc(nnodes, sizeof(unsigned long));
+   sim->nsent = (unsigned long *)calloc(nnodes, sizeof(unsigned long));
+   sim->nlps = nlps;
+   sim->lps = (struct lp *)calloc(nlps, sizeof(struct lp));
+   for (i=0; i<nlps; i++) {
+     sim->lps[i].sim = sim;
+     sim->lps[i].id = i;
+     sim->lps[i].evlist = evq_create(evqspec);
+     if (sim->lps[i].evlist == NULL) {
+       printf("unknown event list backend '%s'\n", evqspec);
+       exit(1);
+       }
+     sim->lps[i].outbox = (struct event **)calloc(nlps, sizeof(struct event *));
+     sim->lps[i].returns = (struct event **)calloc(nlps, sizeof(struct event *));
+     /* a packet's cost vector lives in the same pool object as its event,
+        followed by the node of each entry for a delta update */
+     pool_init(&sim->lps[i].evpool, sizeof(struct event) +
+               (deltaupdates ? 2 : 1) * nnodes * sizeof(int));
+     sim->lps[i].clocktime=0.0;  /* initialize time to 0.0 */
+     wheel_init(&sim->lps[i].wheel, 0);
+     trace_initbuf(&sim->lps[i].trace);
+     }
+   return sim;
+}
+
+/* queue the scenario's link changes from time `from` on; a phase starts
+   at 0 and at every time a link changes before the end of the run */
+static void sim_start(struct sim *sim, float from)
+{
+  int i;
+
+  sim->phasestart = (float *)malloc((scenario->nchanges + 1) * sizeof(float));
+  sim->phasestart[0] = 0.0;
+  sim->nphases = 1;
+  for (i=0; i<scenario->nchanges; i++)
+    if (scenario->changes[i].time >= from &&
+        scenario->changes[i].time < stoptime &&
+        scenario->changes[i].time > sim->phasestart[sim->nphases - 1])
+      sim->phasestart[sim->nphases++] = scenario->changes[i].time;
 
    /* initialize future link changes */
-  if (LINKCHANGES==1)   {
-   evptr = (struct event *)malloc(sizeof(struct event));
-   evptr->evtime =  10000.0;
-   evptr->evtype =  LINK_CHANGE;
-   evptr->eventity =  -1;
-   evptr->rtpktptr =  NULL;
-   insertevent(evptr);
-   evptr = (struct event *)malloc(sizeof(struct event));
-   evptr->evtype =  LINK_CHANGE;
-   evptr->evtime =  20000.0;
-   evptr->rtpktptr =  NULL;
-   insertevent(evptr);    
-   }
-  
+  for (i=0; i<scenario->nchanges; i++)
+    if (scenario->changes[i].time >= from)
+      schedulelinkchange(&scenario->changes[i]);
+
+  for (i=0; i<sim->nlps; i++) {
+    sim->lps[i].lastdelivery = (float *)calloc(sim->nphases, sizeof(float));
+    sim->lps[i].lastchange = (float *)calloc(sim->nphases, sizeof(float));
+    sim->lps[i].phasedelivered = (unsigned long *)calloc(sim->nphases,
+                                                 sizeof(unsigned long));
+    }
+}
+
+struct sim *sim_create(uint64_t simseed)  /* initialize the simulator */
+{
+  struct sim *sim;
+  int i;
+
+   sim = sim_alloc(simseed);
+   for (i=0; i<nnodes; i++) {
+     curlp = &sim->lps[LPOF(sim, i)];
+     rtinit(&sim->routers[i], i);
+     }
+   sim_start(sim, 0.0);
+   return sim;
+}
+
+/************************** CHECKPOINTS ***************************/
+/* A snapshot (see snapshot.h) holds, after its header: the jimsrand()
+   stream, the channels, the per-node counters, the totals of what has
+   been delivered so far, every router's state (rtsave()) and the pending
+   events in the order they would be taken off the event list, each a
+   struct snapevent followed by its packet's entries.  The counters and
+   keys that break ties carry on where they were, so with the same seed
+   a restored run goes on exactly as the one the snapshot came from. */
+
+struct snapevent {
+  float evtime;
+  int32_t evtype;
+  int32_t eventity;
+  int32_t linkid;
+  int32_t linkcost;
+  int32_t sourceid;
+  int32_t destid;
+  int32_t nentries;
+  int32_t hasdest;       /* a delta update: dest[] follows mincost[] */
+  uint64_t evseq;
+};
+
+struct snaptotals {
+  float lastdelivery;
+  float lastchange;
+  unsigned long ndelivered;
+  unsigned long nentries;
+  int peakdepth;
+};
+
+struct evarray {
+  struct event **ev;
+  long n;
+};
+
+static void collectevent(struct event *p, void *arg)
+{
+  struct evarray *a = arg;
+
+  a->ev[a->n++] = p;
+}
+
+/* the order events come off the event list in */
+static int cmpevent(const void *a, const void *b)
+{
+  const struct event *x = *(struct event *const *)a;
+  const struct event *y = *(struct event *const *)b;
+
+  if (x->evtime != y->evtime)
+    return x->evtime < y->evtime ? -1 : 1;
+  return (x->evseq < y->evseq) - (x->evseq > y->evseq);
+}
+
+static void savestate(struct sim *sim, struct snapbuf *b, struct evarray *a,
+                      float clock)
+{
+  struct snaphdr h;
+  struct snaptotals tot;
+  struct snapevent se;
+  struct event *p;
+  long i;
+  int k;
+
+  memset(&h, 0, sizeof(h));
+  h.magic = SNAP_MAGIC;
+  h.version = SNAP_VERSION;
+  h.nnodes = nnodes;
+  h.nedges = topo->nedges;
+  h.topohash = snap_topohash(topo);
+  h.policy = rtpolicy;
+  h.delta = deltaupdates;
+  h.holddown = holddown;
+  h.advertise = advertise;
+  h.timeout = routetimeout;
+  h.coalesce = coalesce;
+  h.clock = clock;
+  h.seed = sim->seed;
+  h.nevents = a->n;
+  snap_put(b, &h, sizeof(h));
+  snap_put(b, sim->rng, sizeof(sim->rng));
+  snap_put(b, sim->channels, topo->nedges * sizeof(struct channel));
+  snap_put(b, sim->txq, sim->txqat[topo->nedges] * sizeof(float));
+  snap_put(b, &sim->nlinkchanges, sizeof(sim->nlinkchanges));
+  snap_put(b, sim->ntimers, nnodes * sizeof(unsigned long));
+  snap_put(b, sim->nsent, nnodes * sizeof(unsigned long));
+  memset(&tot, 0, sizeof(tot));
+  for (i=0; i<sim->nlps; i++) {
+    for (k=0; k<sim->nphases; k++)
+      if (sim->lps[i].lastdelivery[k] > tot.lastdelivery)
+        tot.lastdelivery = sim->lps[i].lastdelivery[k];
+    for (k=0; k<sim->nphases; k++)
+      if (sim->lps[i].lastchange[k] > tot.lastchange)
+        tot.lastchange = sim->lps[i].lastchange[k];
+    tot.ndelivered += sim->lps[i].ndelivered;
+    tot.nentries += sim->lps[i].nentries;
+    tot.peakdepth += sim->lps[i].peakdepth;
+    }
+  snap_put(b, &tot, sizeof(tot));
+  for (i=0; i<nnodes; i++)
+    rtsave(&sim->routers[i], b);
+  for (i=0; i<a->n; i++) {
+    p = a->ev[i];
+    memset(&se, 0, sizeof(se));
+    se.evtime = p->evtime;
+    se.evtype = p->evtype;
+    se.eventity = p->eventity;
+    se.linkid = p->linkid;
+    se.linkcost = p->linkcost;
+    se.evseq = p->evseq;
+    if (p->evtype == FROM_LAYER2) {
+      se.sourceid = p->pkt.sourceid;
+      se.destid = p->pkt.destid;
+      se.nentries = p->pkt.nentries;
+      se.hasdest = p->pkt.dest != NULL;
+      }
+    snap_put(b, &se, sizeof(se));
+    snap_put(b, p->pkt.mincost, se.nentries * sizeof(int));
+    if (se.hasdest)
+      snap_put(b, p->pkt.dest, se.nentries * sizeof(int));
+    }
+}
+
+/* write the state of a run stopped by sim_rununtil(sim, clock); 0 on error */
+int sim_save(struct sim *sim, const char *path, float clock)
+{
+  struct snapbuf b;
+  struct evarray a;
+  long n;
+  int i;
+
+  n = 0;
+  for (i=0; i<sim->nlps; i++)
+    n += evq_size(sim->lps[i].evlist);
+  a.ev = (struct event **)malloc((n ? n : 1) * sizeof(struct event *));
+  a.n = 0;
+  for (i=0; i<sim->nlps; i++)
+    evq_foreach(sim->lps[i].evlist, collectevent, &a);
+  qsort(a.ev, a.n, sizeof(struct event *), cmpevent);
+
+  memset(&b, 0, sizeof(b));
+  savestate(sim, &b, &a, clock);      /* size it */
+  b.size = b.off;
+  b.off = 0;
+  b.base = snap_create(path, b.size);
+  if (b.base == NULL) {
+    free(a.ev);
+    return 0;
+    }
+  savestate(sim, &b, &a, clock);
+  free(a.ev);
+  if (!snap_close(b.base, b.size)) {
+    perror(path);
+    return 0;
+    }
+  return 1;
+}
+
+/* a run that takes up from the snapshot in map, of size bytes.  With the
+   seed the snapshot was taken with it carries on exactly as the original
+   run would have; with any other, its random streams are new.  Link
+   changes the snapshot had pending are dropped: the current scenario's
+   changes from the snapshot's clock on are made instead. */
+struct sim *sim_restore(void *map, size_t size, uint64_t simseed)
+{
+  struct snapbuf b;
+  struct snaphdr h;
+  struct snaptotals tot;
+  struct snapevent se;
+  struct channel ch;
+  struct event *p;
+  uint64_t rng[4];
+  size_t *at;
+  struct sim *sim;
+  long i;
+  int k;
+
+  memset(&b, 0, sizeof(b));
+  b.base = map;
+  b.size = size;
+  snap_get(&b, &h, sizeof(h));
+  if (h.nnodes != nnodes || h.nedges != topo->nedges ||
+      h.topohash != snap_topohash(topo)) {
+    printf("the snapshot was taken on another network\n");
+    exit(1);
+    }
+  if (h.policy != rtpolicy || h.delta != deltaupdates ||
+      h.holddown != holddown || h.advertise != advertise ||
+      h.timeout != routetimeout || h.coalesce != coalesce) {
+    printf("the snapshot was taken with other -p, -d, -H, -A, -O or -W "
+           "settings\n");
+    exit(1);
+    }
+
+  sim = sim_alloc(simseed);
+  snap_get(&b, rng, sizeof(rng));
+  if (simseed == h.seed)
+    memcpy(sim->rng, rng, sizeof(rng));
+  for (i=0; i<topo->nedges; i++) {
+    snap_get(&b, &ch, sizeof(ch));
+    sim->channels[i].lastarrival = ch.lastarrival;
+    sim->channels[i].nsent = ch.nsent;
+    if (simseed == h.seed)
+      sim->channels[i].rng = ch.rng;
+    sim->channels[i].busyuntil = ch.busyuntil;
+    sim->channels[i].qhead = ch.qhead;
+    sim->channels[i].qlen = ch.qlen;
+    sim->channels[i].busy = ch.busy;
+    sim->channels[i].bytes = ch.bytes;
+    sim->channels[i].ndropped = ch.ndropped;
+    sim->channels[i].nlost = ch.nlost;
+    }
+  snap_get(&b, sim->txq, sim->txqat[topo->nedges] * sizeof(float));
+  snap_get(&b, &sim->nlinkchanges, sizeof(sim->nlinkchanges));
+  snap_get(&b, sim->ntimers, nnodes * sizeof(unsigned long));
+  snap_get(&b, sim->nsent, nnodes * sizeof(unsigned long));
+  snap_get(&b, &tot, sizeof(tot));
+  for (i=0; i<sim->nlps; i++)        /* the routers put their timers back */
+    wheel_init(&sim->lps[i].wheel, (uint64_t)((double)h.clock * WHEELHZ));
+  for (i=0; i<nnodes; i++) {
+    curlp = &sim->lps[LPOF(sim, i)];
+    rtrestore(&sim->routers[i], i, &b);
+    }
+
+  /* queue the events latest first, so that those due at the same time
+     get insertion numbers in the order they had */
+  at = (size_t *)malloc((h.nevents ? h.nevents : 1) * sizeof(size_t));
+  for (i=0; i<(long)h.nevents && !b.overrun; i++) {
+    at[i] = b.off;
+    snap_get(&b, &se, sizeof(se));
+    /* what a live event is checked for before it is handled, and the
+       ends of a packet, which index the routers' state */
+    if (se.nentries < 0 || se.nentries > nnodes ||
+        se.evtype < 0 || se.evtype >= NHANDLERS ||
+        handlers[se.evtype] == NULL ||
+        se.eventity < 0 || se.eventity >= nnodes ||
+        (se.hasdest && !deltaupdates) ||
+        (se.evtype == FROM_LAYER2 &&
+         (se.sourceid < 0 || se.sourceid >= nnodes ||
+          se.destid != se.eventity)))
+      b.overrun = 1;
+    else
+      b.off += (se.hasdest ? 2 : 1) * se.nentries * sizeof(int);
+    }
+  if (b.overrun || b.off != b.size) {
+    printf("the snapshot is damaged\n");
+    exit(1);
+    }
+  for (i=(long)h.nevents-1; i>=0; i--) {
+    b.off = at[i];
+    snap_get(&b, &se, sizeof(se));
+    if (se.evtype == LINK_CHANGE)
+      continue;
+    curlp = &sim->lps[LPOF(sim, se.eventity)];
+    p = newevent();
+    p->evtime = se.evtime;
+    p->evtype = se.evtype;
+    p->eventity = se.eventity;
+    p->linkid = se.linkid;
+    p->linkcost = se.linkcost;
+    p->evseq = se.evseq;
+    p->pkt.sourceid = se.sourceid;
+    p->pkt.destid = se.destid;
+    p->pkt.nentries = se.nentries;
+    snap_get(&b, p->pkt.mincost, se.nentries * sizeof(int));
+    if (se.hasdest) {
+      p->pkt.dest = p->pkt.mincost + nnodes;
+      snap_get(&b, p->pkt.dest, se.nentries * sizeof(int));
+      for (k=0; k<se.nentries; k++)
+        if (p->pkt.dest[k] < 0 || p->pkt.dest[k] >= nnodes) {
+          printf("the snapshot is damaged\n");
+          exit(1);
+          }
+      }
+    else
+      p->pkt.dest = NULL;
+    insertevent(p);
+    }
+  free(at);
+
+  for (i=0; i<sim->nlps; i++)
+    sim->lps[i].clocktime = h.clock;
+  sim_start(sim, h.clock);
+  /* everything delivered before the snapshot counts as the first phase */
+  sim->lps[0].lastdelivery[0] = tot.lastdelivery;
+  sim->lps[0].lastchange[0] = tot.lastchange;
+  sim->lps[0].phasedelivered[0] = tot.ndelivered;
+  sim->lps[0].ndelivered = tot.ndelivered;
+  sim->lps[0].nentries = tot.nentries;
+  sim->lps[0].peakdepth += tot.peakdepth;
+  return sim;
+}
+
+void sim_destroy(struct sim *sim)
+{
+  int i;
+
+  for (i=0; i<nnodes; i++)
+    rtfree(&sim->routers[i]);
+  for (i=0; i<sim->nlps; i++) {
+    pool_destroy(&sim->lps[i].evpool);
+    evq_destroy(sim->lps[i].evlist);
+    free(sim->lps[i].outbox);
+    free(sim->lps[i].returns);
+    free(sim->lps[i].lastdelivery);
+    free(sim->lps[i].lastchange);
+    free(sim->lps[i].phasedelivered);
+    trace_freebuf(&sim->lps[i].trace);
+    }
+  free(sim->lps);
+  free(sim->routers);
+  free(sim->channels);
+  free(sim->txq);
+  free(sim->txqat);
+  free(sim->ntimers);
+  free(sim->nsent);
+  free(sim->phasestart);
+  free(sim);
 }
 
 /****************************************************************************/
 /* jimsrand(): return a float in range [0,1].  The routine below is used to */
-/* isolate all random number generation in one location.  We assume that the*/
-/* system-supplied rand() function return an int in therange [0,mmm]        */
+/* isolate all random number generation in one location.  Every run has its */
+/* own xoshiro256** stream, seeded from -s, instead of the process-wide     */
+/* rand(), so runs going on at the same time do not disturb each other.     */
 /****************************************************************************/
-float jimsrand() 
+float jimsrand()
 {
-  double mmm = 2147483647;   /* largest int  - MACHINE DEPENDENT!!!!!!!!   */
-  float x;                   /* individual students may need to change mmm */ 
-  x = rand()/mmm;            /* x should be uniform in [0,1] */
-  return(x);
-}  
+  return rng_float(xoshiro256ss(cursim->rng));
+}
 
 /********************* EVENT HANDLINE ROUTINES *******/
 /*  The next set of routines handle the event list   */
 /*****************************************************/
- 
 
-insertevent(p)
-   struct event *p;
+
+/* events and the packet they carry are one pool object: the cost
+   vector, and the nodes of a delta update, follow the struct event */
+struct event *newevent()
+{
+   struct event *evptr;
+
+   evptr = (struct event *)pool_get(&curlp->evpool);
+   evptr->pkt.mincost = (int *)(evptr + 1);
+   evptr->pkt.dest = deltaupdates ? evptr->pkt.mincost + nnodes : NULL;
+   evptr->evowner = curlp->id;
+   return evptr;
+}
+
+/* an event made by another lp goes back to it at the end of the window */
+void freeevent(struct event *evptr)
 {
-   struct event *q,*qold;
+   if (evptr->evowner == curlp->id)
+     pool_put(&curlp->evpool, evptr);
+   else {
+     evptr->next = curlp->returns[evptr->evowner];
+     curlp->returns[evptr->evowner] = evptr;
+     }
+}
+
+/* queue an event at the lp owning its node; with a lookahead, ties are
+   broken by the evseq the caller chose rather than by insertion order */
+void insertevent(struct event *p)
+{
+   struct lp *lp = &cursim->lps[LPOF(cursim, p->eventity)];
 
    if (TRACE>3) {
-      printf("            INSERTEVENT: time is %lf\n",clocktime);
-      printf("            INSERTEVENT: future time will be %lf\n",p->evtime); 
+      printf("            INSERTEVENT: time is %lf\n",curlp->clocktime);
+      printf("            INSERTEVENT: future time will be %lf\n",p->evtime);
       }
-   q = evlist;     /* q points to header of list in which p struct inserted */
-   if (q==NULL) {   /* list is empty */
-        evlist=p;
-        p->next=NULL;
-        p->prev=NULL;
-        }
-     else {
-        for (qold = q; q !=NULL && p->evtime > q->evtime; q=q->next)
-              qold=q; 
-        if (q==NULL) {   /* end of list */
-             qold->next = p;
-             p->prev = qold;
-             p->next = NULL;
-             }
-           else if (q==evlist) { /* front of list */
-             p->next=evlist;
-             p->prev=NULL;
-             p->next->prev=p;
-             evlist = p;
-             }
-           else {     /* middle of list */
-             p->next=q;
-             p->prev=q->prev;
-             q->prev->next=p;
-             q->prev=p;
-             }
-         }
+   if (lp != curlp) {
+     p->next = curlp->outbox[lp->id];
+     curlp->outbox[lp->id] = p;
+     }
+   else {
+     if (lookahead > 0.0)
+       evq_insertkeyed(lp->evlist, p);
+     else
+       evq_insert(lp->evlist, p);
+     if (evq_size(lp->evlist) > lp->peakdepth)
+       lp->peakdepth = evq_size(lp->evlist);
+     }
+}
+
+/* timers stay on the router's own lp.  With a lookahead, ties are
+   broken by router and timer number, which no channel's key can equal */
+void starttimer(int node, float delay, int arg)
+{
+   struct event *evptr;
+
+   evptr = newevent();
+   evptr->evtime = curlp->clocktime + delay;
+   evptr->evtype = ROUTER_TIMER;
+   evptr->eventity = node;
+   evptr->linkid = arg;
+   evptr->evseq = ((unsigned long)(topo->nedges + node) << 32) |
+                  (cursim->ntimers[node]++ & 0xffffffffUL);
+   insertevent(evptr);
+}
+
+void armtimer(struct wtimer *t, int node, float delay, int arg)
+{
+   double at = ((double)curlp->clocktime + delay) * WHEELHZ;
+   uint64_t tick = WHEEL_MAXTICK;
+
+   if (at < (double)WHEEL_MAXTICK) {
+     tick = (uint64_t)at;
+     if ((double)tick < at)
+       tick++;
+     }
+   t->node = node;
+   t->arg = arg;
+   wheel_arm(&curlp->wheel, t, tick);
+}
+
+void canceltimer(struct wtimer *t)
+{
+   wheel_cancel(&curlp->wheel, t);
+}
+
+void rearmtimer(struct wtimer *t)
+{
+   t->state = WT_IDLE;
+   wheel_arm(&curlp->wheel, t, t->expires);
+}
+
+float rtclock(void)
+{
+   return curlp->clocktime;
+}
+
+static void printevent(struct event *q, void *arg)
+{
+  (void)arg;
+  printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
 }
 
-printevlist()
+void printevlist()
 {
-  struct event *q;
   printf("--------------\nEvent List Follows:\n");
-  for(q = evlist; q!=NULL; q=q->next) {
-    printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
-    }
+  evq_foreach(curlp->evlist, printevent, NULL);
   printf("--------------\n");
 }
 
 
 /************************** TOLAYER2 ***************/
-tolayer2(packet)
-  struct rtpkt packet;
-  
+/* a packet of size bytes handed to channel ch of edge, which sends what
+   it is given in order, each packet taking bytes/bandwidth.  With a
+   bounded queue a packet that finds it full is dropped; one that is
+   sent may be lost on the way.  Returns when the last bit is sent, or
+   -1 if the packet will not arrive. */
+static float transmit(struct channel *ch, int edge, int bytes)
+{
+  const struct linkmodel *lm = topo_link(topo, edge);
+  float *q = &cursim->txq[cursim->txqat[edge]];
+  float now = curlp->clocktime, tx, draw;
+
+  if (lm->queue > 0) {
+    while (ch->qlen > 0 && q[ch->qhead] <= now) {   /* sent by now */
+      ch->qhead = (ch->qhead + 1) % lm->queue;
+      ch->qlen--;
+      }
+    if (ch->qlen == lm->queue) {
+      ch->ndropped++;
+      return -1.0;
+      }
+    }
+  tx = lm->bandwidth > 0.0 ? bytes / lm->bandwidth : 0.0;
+  if (ch->busyuntil < now)
+    ch->busyuntil = now;
+  ch->busyuntil += tx;
+  ch->busy += tx;
+  ch->bytes += bytes;
+  if (lm->queue > 0)
+    q[(ch->qhead + ch->qlen++) % lm->queue] = ch->busyuntil;
+  if (lm->loss > 0.0) {
+    draw = lookahead > 0.0 ? rng_float(splitmix64(&ch->rng)) : jimsrand();
+    if (draw < lm->loss) {
+      ch->nlost++;
+      return -1.0;
+      }
+    }
+  return ch->busyuntil;
+}
+
+void tolayer2(struct rtpkt packet)
 {
  struct rtpkt *mypktptr;
- struct event *evptr, *q;
- float jimsrand(),lastime;
- int i;
-
- int connectcosts[4][4];
-
- /* initialize by hand since not all compilers allow array initilization */
- connectcosts[0][0]=0;  connectcosts[0][1]=1;  connectcosts[0][2]=3;
- connectcosts[0][3]=7;
- connectcosts[1][0]=1;  connectcosts[1][1]=0;  connectcosts[1][2]=1;
- connectcosts[1][3]=999;
- connectcosts[2][0]=3;  connectcosts[2][1]=1;  connectcosts[2][2]=0;
- connectcosts[2][3]=2;
- connectcosts[3][0]=7;  connectcosts[3][1]=999;  connectcosts[3][2]=2;
- connectcosts[3][3]=0;
-    
+ struct event *evptr;
+ struct channel *ch;
+ const struct linkmodel *lm;
+ float jimsrand(),lastime,sent;
+ int i, edge;
+
  /* be nice: check if source and destination id's are reasonable */
- if (packet.sourceid<0 || packet.sourceid >3) {
+ if (packet.sourceid<0 || packet.sourceid >=nnodes) {
    printf("WARNING: illegal source id in your packet, ignoring packet!\n");
    return;
    }
- if (packet.destid<0 || packet.destid >3) {
+ if (packet.destid<0 || packet.destid >=nnodes) {
    printf("WARNING: illegal dest id in your packet, ignoring packet!\n");
    return;
    }
@@ -279,44 +1886,96 @@ tolayer2(packet)
    printf("WARNING: source and destination id's the same, ignoring packet!\n");
    return;
    }
- if (connectcosts[packet.sourceid][packet.destid] == 999)  {
+ edge = topo_edge(topo, packet.sourceid, packet.destid);
+ if (edge < 0)  {
    printf("WARNING: source and destination not connected, ignoring packet!\n");
    return;
    }
 
+/* the link may drop or lose it */
+ ch = &cursim->channels[edge];
+ lm = topo_link(topo, edge);
+ curlp->nentries += packet.nentries;
+ cursim->nsent[packet.sourceid]++;
+ sent = transmit(ch, edge, RTPKT_BYTES(&packet));
+ if (sent < 0.0) {
+   if (TRACE>2)
+     printf("    TOLAYER2: source: %d, dest: %d, packet dropped\n",
+            packet.sourceid, packet.destid);
+   if (curlp->trace.rec != NULL) {
+     struct tracerec *t = trace_next(&curlp->trace);
+
+     t->type = TR_DROP;
+     t->time = t->arrival = curlp->clocktime;
+     t->lp = curlp->id;
+     t->node = packet.sourceid;
+     t->peer = packet.destid;
+     t->value = packet.nentries;
+     }
+   return;
+   }
+
+/* create future event for arrival of packet at the other side */
+  evptr = newevent();
+  evptr->evtype =  FROM_LAYER2;   /* packet will pop out from layer3 */
+  evptr->eventity = packet.destid; /* event occurs at other entity */
+
 /* make a copy of the packet student just gave me since he/she may decide */
-/* to do something with the packet after we return back to him/her */ 
- mypktptr = (struct rtpkt *) malloc(sizeof(struct rtpkt));
+/* to do something with the packet after we return back to him/her */
+ mypktptr = &evptr->pkt;
  mypktptr->sourceid = packet.sourceid;
  mypktptr->destid = packet.destid;
- for (i=0; i<4; i++)
+ mypktptr->nentries = packet.nentries;
+ for (i=0; i<packet.nentries; i++)
     mypktptr->mincost[i] = packet.mincost[i];
+ if (packet.dest != NULL)
+   for (i=0; i<packet.nentries; i++)
+      mypktptr->dest[i] = packet.dest[i];
+ else
+   mypktptr->dest = NULL;
  if (TRACE>2)  {
-   printf("    TOLAYER2: source: %d, dest: %d\n              costs:", 
+   printf("    TOLAYER2: source: %d, dest: %d\n              costs:",
           mypktptr->sourceid, mypktptr->destid);
-   for (i=0; i<4; i++)
-        printf("%d  ",mypktptr->mincost[i]);
+   for (i=0; i<packet.nentries; i++)
+        if (packet.dest != NULL)
+          printf("%d:%d  ",mypktptr->dest[i],mypktptr->mincost[i]);
+        else
+          printf("%d  ",mypktptr->mincost[i]);
     printf("\n");
    }
 
-/* create future event for arrival of packet at the other side */
-  evptr = (struct event *)malloc(sizeof(struct event));
-  evptr->evtype =  FROM_LAYER2;   /* packet will pop out from layer3 */
-  evptr->eventity = packet.destid; /* event occurs at other entity */
-  evptr->rtpktptr = mypktptr;       /* save ptr to my copy of packet */
-
-/* finally, compute the arrival time of packet at the other end.
-   medium can not reorder, so make sure packet arrives between 1 and 10
-   time units after the latest arrival time of packets
-   currently in the medium on their way to the destination */
- lastime = clocktime;
- for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==FROM_LAYER2  && q->eventity==evptr->eventity) ) 
-      lastime = q->evtime;
- evptr->evtime =  lastime + 2.*jimsrand();
-
- 
- if (TRACE>2)  
+/* finally, compute the arrival time of packet at the other end: the
+   link's delay after it is sent, plus 0 to jitter (2 by default).
+   medium can not reorder, so make sure packet arrives after the
+   latest arrival time of packets currently in the medium on this
+   channel; then add the lookahead */
+ lastime = sent + lm->delay;
+ if (ch->lastarrival > lastime)
+   lastime = ch->lastarrival;
+ if (lookahead > 0.0) {
+   /* in float, so the result is never below the end of this window */
+   lastime += lookahead;
+   evptr->evtime = lastime + lm->jitter*rng_float(splitmix64(&ch->rng));
+   evptr->evseq = ((unsigned long)edge << 32) | (ch->nsent & 0xffffffffUL);
+   }
+ else
+   evptr->evtime =  lastime + (double)lm->jitter*jimsrand();
+ ch->lastarrival = evptr->evtime;
+ ch->nsent++;
+ if (curlp->trace.rec != NULL) {
+   struct tracerec *t = trace_next(&curlp->trace);
+
+   t->type = TR_SEND;
+   t->time = curlp->clocktime;
+   t->arrival = evptr->evtime;
+   t->lp = curlp->id;
+   t->node = packet.sourceid;
+   t->peer = packet.destid;
+   t->value = packet.nentries;
+   }
+
+
+ if (TRACE>2)
      printf("    TOLAYER2: scheduling arrival on other side\n");
  insertevent(evptr);
-} 
+}
@@ -0,0 +1,65 @@
+/* ******************************************************************
+ Declarations shared by the emulator (distance_vector.c) and the
+ modules it is built from.
+**********************************************************************/
+#ifndef DISTANCE_VECTOR_H
+#define DISTANCE_VECTOR_H
+
+/* a rtpkt is the packet sent from one routing update process to
+   another via the call tolayer2() */
+struct rtpkt {
+  int sourceid;       /* id of sending router sending this pkt */
+  int destid;         /* id of router to which pkt being sent 
+                         (must be an immediate neighbor) */
+  int *mincost;       /* min cost to node 0 ... nnodes-1, or with
+                         deltaupdates the cost to node dest[k] */
+  int *dest;          /* deltaupdates: the node of each entry */
+  int nentries;       /* entries in mincost[], nnodes for a full vector */
+  };
+
+struct event {
+   float evtime;           /* event time */
+   int evtype;             /* event type code */
+   int eventity;           /* entity where event occurs */
+   struct rtpkt pkt;       /* FROM_LAYER2: the packet being delivered */
+   int linkid;             /* LINK_CHANGE: other end of the link,
+                              ROUTER_TIMER: the router's argument */
+   int linkcost;           /* LINK_CHANGE: its new cost */
+   int evowner;            /* logical process whose pool it came from */
+   unsigned long evseq;    /* breaks ties on evtime, larger first */
+   struct event *prev;
+   struct event *next;
+ };
+
+/* bytes a packet takes on the wire, in dvnet's encoding: a 20 byte
+   header, then 4 per entry, or 8 with the node of each in a delta */
+#define RTPKT_BYTES(p)  (20 + ((p)->dest != NULL ? 8 : 4) * (p)->nentries)
+
+/* possible events: */
+#define  FROM_LAYER2     2
+#define  LINK_CHANGE     10
+#define  ROUTER_TIMER    11
+
+extern int TRACE;
+extern int deltaupdates;   /* send only the entries that changed */
+extern int nnodes;
+extern struct topology *topo;
+
+void creatertpkt(struct rtpkt *initrtpkt, int srcid, int destid, int *mincosts);
+void tolayer2(struct rtpkt packet);
+/* call rttimer(arg) on router node delay time units from now */
+void starttimer(int node, float delay, int arg);
+
+/* The router's own timers, on a timing wheel (twheel.h) beside the event
+   list, for timers that are re-armed all the time: t, which the router
+   keeps, calls rttimer(arg) on router node delay time units from now,
+   rounded up to the wheel's tick.  Arming an armed timer moves it. */
+struct wtimer;
+void armtimer(struct wtimer *t, int node, float delay, int arg);
+void canceltimer(struct wtimer *t);
+/* put back a timer whose node, arg and expiry came from a snapshot */
+void rearmtimer(struct wtimer *t);
+/* the time now, in the units of the delays */
+float rtclock(void);
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "dvkernels.h"
+#include "router.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DVK_X86 1
+#include <immintrin.h>
+#endif
+
+/******************************** generic ********************************/
+
+static int relax_generic(int *col, const int *vec, int linkcost, int n)
+{
+  int i, cand, changed = 0;
+
+  for (i = 0; i < n; i++) {
+    cand = linkcost + vec[i];
+    if (cand > INFINITY)
+      cand = INFINITY;
+    if (cand < col[i]) {
+      col[i] = cand;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+#ifdef DVK_X86
+/********************************* SSE4.1 ********************************/
+
+__attribute__((target("sse4.1")))
+static int relax_sse41(int *col, const int *vec, int linkcost, int n)
+{
+  __m128i c = _mm_set1_epi32(linkcost), inf = _mm_set1_epi32(INFINITY);
+  __m128i cand, old, lower = _mm_setzero_si128();
+  int i, changed;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    cand = _mm_min_epi32(_mm_add_epi32(c, _mm_loadu_si128((const __m128i *)(vec + i))), inf);
+    old = _mm_loadu_si128((const __m128i *)(col + i));
+    lower = _mm_or_si128(lower, _mm_cmplt_epi32(cand, old));
+    _mm_storeu_si128((__m128i *)(col + i), _mm_min_epi32(cand, old));
+  }
+  changed = !_mm_testz_si128(lower, lower);
+  return relax_generic(col + i, vec + i, linkcost, n - i) | changed;
+}
+
+/********************************** AVX2 *********************************/
+
+__attribute__((target("avx2")))
+static int relax_avx2(int *col, const int *vec, int linkcost, int n)
+{
+  __m256i c = _mm256_set1_epi32(linkcost), inf = _mm256_set1_epi32(INFINITY);
+  __m256i cand, old, lower = _mm256_setzero_si256();
+  int i, changed;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    cand = _mm256_min_epi32(_mm256_add_epi32(c, _mm256_loadu_si256((const __m256i *)(vec + i))), inf);
+    old = _mm256_loadu_si256((const __m256i *)(col + i));
+    lower = _mm256_or_si256(lower, _mm256_cmpgt_epi32(old, cand));
+    _mm256_storeu_si256((__m256i *)(col + i), _mm256_min_epi32(cand, old));
+  }
+  changed = !_mm256_testz_si256(lower, lower);
+  return relax_generic(col + i, vec + i, linkcost, n - i) | changed;
+}
+#endif /* DVK_X86 */
+
+/******************************** dispatch *******************************/
+
+static const struct {
+  const char *name;
+  int (*relax)(int *, const int *, int, int);
+} kernels[] = {                          /* best first */
+#ifdef DVK_X86
+  { "avx2", relax_avx2 },
+  { "sse4.1", relax_sse41 },
+#endif
+  { "generic", relax_generic },
+};
+#define NKERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+int (*dvk_relax)(int *, const int *, int, int) = relax_generic;
+static const char *selected = "generic";
+
+static int supported(const char *name)
+{
+#ifdef DVK_X86
+  __builtin_cpu_init();
+  if (strcmp(name, "avx2") == 0)
+    return __builtin_cpu_supports("avx2");
+  if (strcmp(name, "sse4.1") == 0)
+    return __builtin_cpu_supports("sse4.1");
+#endif
+  return strcmp(name, "generic") == 0;
+}
+
+int dvk_select(const char *name)
+{
+  int k;
+
+  for (k = 0; k < NKERNELS; k++) {
+    if (name != NULL && strcmp(name, kernels[k].name) != 0)
+      continue;
+    if (!supported(kernels[k].name)) {
+      if (name != NULL)
+        return 0;
+      continue;
+    }
+    dvk_relax = kernels[k].relax;
+    selected = kernels[k].name;
+    return 1;
+  }
+  return 0;
+}
+
+const char *dvk_name(void)
+{
+  return selected;
+}
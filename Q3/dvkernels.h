@@ -0,0 +1,22 @@
+/* ******************************************************************
+ Vector kernels for the inner loop of the routing process, the
+ Bellman-Ford relaxation of one received vector.  It has an AVX2, an
+ SSE4.1 and a portable version; the fastest one the CPU supports is
+ picked when the program starts, or a slower one can be forced by name.
+
+ Sums saturate at INFINITY, so an unreachable destination stays
+ unreachable however long the path to it gets.
+**********************************************************************/
+#ifndef DVKERNELS_H
+#define DVKERNELS_H
+
+/* col[i] = min(col[i], min(linkcost + vec[i], INFINITY)) for i < n;
+   returns nonzero if any col[i] went down */
+extern int (*dvk_relax)(int *col, const int *vec, int linkcost, int n);
+
+/* "avx2", "sse4.1" or "generic"; NULL picks the best supported.
+   Returns 0 if the named kernels are unknown or unsupported here. */
+int dvk_select(const char *name);
+const char *dvk_name(void);
+
+#endif
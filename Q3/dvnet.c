@@ -0,0 +1,1233 @@
+/* ******************************************************************
+ dvnet: the routers in real time, one process per node, exchanging
+ their updates as UDP datagrams over the loopback interface, or with
+ -j as threads in one process exchanging them through rings.
+
+   dvnet [-t topology] [-S scenario] [-p legacy|bf|poison] [-d]
+         [-H holddown] [-u ms] [-Q ms] [-j threads] [-T trace] [-V]
+
+ Every router runs router.c unchanged; this file stands in for the
+ emulator's tolayer2() and starttimer().  A packet goes to the
+ neighbor's socket as a header and its costs (with -d, and the nodes
+ they are for) as they are in memory.  A router takes the datagrams
+ waiting for it with one recvmmsg() and sends what handling them
+ produced with one sendmmsg().
+
+ With -j the routers are shared out among that many threads, and every
+ direction of every link is a lock-free single-producer single-consumer
+ ring holding the same records a datagram would: the sender's thread
+ appends, the receiver's thread hands them to rtupdate() where they lie.
+ A packet that finds its ring full waits, in order, in a list kept by
+ the sender, so no thread ever blocks on another and nothing is lost.
+
+ The parent process (or thread) is the controller.  It starts the
+ routers together, makes the scenario's link changes at their times, -u
+ milliseconds per unit of time (0.1 by default), and stops the routers
+ once the last change has settled.  Routers report their packet counts
+ to it; a phase has settled once no count has moved for -Q milliseconds
+ (default 200), and with -j once every packet sent has been handled.
+ The controller prints the wall clock time each phase took to settle,
+ the packets, bytes, system calls (or waits for a ring) and CPU time it
+ took, and the updates handled per second while the network was
+ settling.  With -V the routers' final minimum costs are checked against
+ the cheapest paths (oracle.h), and dvnet exits with status 1 if any is
+ wrong.
+
+ Loopback UDP can drop datagrams when a socket's receive buffer is
+ full; the routers do not resend, so drops are counted and reported.
+**********************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "distance_vector.h"
+#include "router.h"
+#include "topology.h"
+#include "scenario.h"
+#include "evqueue.h"
+#include "oracle.h"
+#include "twheel.h"
+
+#define BATCH       64            /* datagrams per sendmmsg()/recvmmsg() */
+#define MAXDGRAM    65507         /* largest UDP datagram over IPv4 */
+#define RCVBUF      (8 << 20)     /* asked for; the kernel may give less */
+#define RINGPKTS    16            /* largest packets a link's ring holds, */
+#define RINGBYTES   (256 << 20)   /* unless the rings would need more */
+#define CMDRING     65536         /* bytes of a thread's command ring */
+#define SPINS       64            /* idle passes that yield before sleeping */
+
+/* what is in a datagram, or a ring record */
+enum {
+  W_VECTOR,              /* router to router: a struct rtpkt */
+  W_START,               /* controller to router: run rtinit() */
+  W_LINK,                /* controller to router: a link changed */
+  W_QUIT,                /* controller to router: send W_FINAL and stop */
+  W_REPORT,              /* router to controller: struct netcounts */
+  W_FINAL,               /* router to controller: struct netcounts, then
+                            with -V its minimum costs */
+  W_PAD,                 /* ring: the rest up to the end is unused */
+};
+
+struct wirehdr {
+  int32_t type;
+  int32_t sourceid;      /* router that sent it, -1 for the controller */
+  int32_t destid;
+  int32_t arg[2];        /* W_VECTOR: entries, 1 if their nodes follow
+                            the costs; W_LINK: other end, new cost;
+                            W_FINAL: minimum costs that follow */
+};
+
+struct netcounts {
+  uint64_t sent;         /* W_VECTOR datagrams sent */
+  uint64_t handled;      /* and received and handed to rtupdate() */
+  uint64_t bytes;        /* in those sent */
+  uint64_t sendcalls;    /* sendmmsg() calls */
+  uint64_t recvcalls;    /* recvmmsg() calls that returned datagrams */
+  uint64_t waited;       /* -j: packets that found their ring full */
+  uint64_t changed;      /* times a best route changed */
+  double cpu;            /* user and system seconds, in W_FINAL; with -j
+                            those of the passes that did something */
+  double when;           /* when these were the counts, see nowms() */
+};
+
+int TRACE = 0;
+int deltaupdates = 0;            /* -d */
+int nnodes;
+struct topology *topo;
+
+static float unitms = 0.1;       /* -u: milliseconds per unit of time */
+static float quietms = 200.0;    /* -Q: how long a settled network is quiet */
+static int nthreads = 0;         /* -j: threads, 0 for a process per router */
+static int validate = 0;         /* -V */
+
+static struct sockaddr_in *addrs;   /* every router's, then the controller's */
+static int *socks;                  /* the same, bound before forking */
+
+/* the router, or with -j the thread of routers, running */
+static __thread struct netcounts cnt;
+static __thread struct evqueue *timers;   /* rttimer() calls, evtime in ms */
+static __thread struct twheel *wheel;     /* armtimer()'s, ticks of 1 ms */
+static __thread double t0;                /* when the routers started */
+
+static double nowms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/* the routers' own timers go on a wheel of 1 ms ticks since t0 */
+void armtimer(struct wtimer *t, int node, float delay, int arg)
+{
+  t->node = node;
+  t->arg = arg;
+  wheel_arm(wheel, t, (uint64_t)(nowms() - t0 + delay * unitms) + 1);
+}
+
+void canceltimer(struct wtimer *t)
+{
+  wheel_cancel(wheel, t);
+}
+
+void rearmtimer(struct wtimer *t)
+{
+  t->state = WT_IDLE;
+  wheel_arm(wheel, t, t->expires);
+}
+
+float rtclock(void)
+{
+  return (nowms() - t0) / unitms;
+}
+
+static void newwheel(void)
+{
+  wheel = malloc(sizeof(*wheel));
+  if (wheel == NULL) {
+    printf("dvnet: out of memory for the timers\n");
+    exit(1);
+  }
+  wheel_init(wheel, 0);
+}
+
+/* the wheel's timers that are due, on the routers from rts[0], which
+   is router first; returns how many went off */
+static int firewheel(struct router *rts, int first)
+{
+  struct wtimer *fired, *t;
+  uint64_t tick;
+  double now = nowms() - t0;
+  int n = 0;
+
+  while ((tick = wheel_next(wheel)) != UINT64_MAX && tick <= now) {
+    fired = wheel_expire(wheel, tick);
+    while ((t = wheel_take(&fired)) != NULL) {
+      rttimer(&rts[t->node - first], t->arg);
+      n++;
+    }
+  }
+  return n;
+}
+
+static size_t reclen(const struct wirehdr *h)
+{
+  if (h->type != W_VECTOR)
+    return sizeof(*h);
+  return sizeof(*h) + (h->arg[1] ? 2 : 1) * (size_t)h->arg[0] * sizeof(int);
+}
+
+static double threadcpu(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cputime(void)
+{
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+/* a batch of datagrams, each with a buffer of up to MAXDGRAM bytes */
+struct dgrams {
+  struct mmsghdr msg[BATCH];
+  struct iovec iov[BATCH];
+  char *buf[BATCH];
+  int n;                         /* queued to send */
+};
+
+static void dgrams_init(struct dgrams *d)
+{
+  int i;
+
+  memset(d, 0, sizeof(*d));
+  for (i = 0; i < BATCH; i++) {
+    d->buf[i] = malloc(MAXDGRAM);
+    if (d->buf[i] == NULL) {
+      printf("dvnet: out of memory\n");
+      exit(1);
+    }
+    d->iov[i].iov_base = d->buf[i];
+    d->iov[i].iov_len = MAXDGRAM;
+    d->msg[i].msg_hdr.msg_iov = &d->iov[i];
+    d->msg[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+static void sendctl(int sock, int to, int type, int a, int b)
+{
+  struct wirehdr h;
+
+  h.type = type;
+  h.sourceid = -1;
+  h.destid = to;
+  h.arg[0] = a;
+  h.arg[1] = b;
+  if (sendto(sock, &h, sizeof(h), 0, (struct sockaddr *)&addrs[to],
+             sizeof(addrs[to])) < 0)
+    perror("dvnet: sendto");
+}
+
+/******************************** RINGS ********************************/
+
+/* A single-producer single-consumer ring of records, each a struct
+   wirehdr and what follows it.  head and tail count the bytes ever put
+   in and taken out, so they only grow; each is written by one side and
+   sits on its own cache line.  A record is never split across the end:
+   one that does not fit there is put at the start, and the rest is
+   marked W_PAD, or left as it is if not even a header fits. */
+struct spill {
+  struct spill *next;
+  struct wirehdr h;
+  int data[];
+};
+
+struct ring {
+  _Alignas(64) _Atomic size_t head;
+  struct spill *spill, *spilltail;  /* the producer's: records waiting for
+                                       room, oldest first */
+  _Alignas(64) _Atomic size_t tail;
+  _Alignas(64) size_t size;         /* a power of two */
+  char *buf;
+};
+
+static int ring_init(struct ring *q, size_t atleast)
+{
+  q->size = 64;
+  while (q->size < atleast)
+    q->size *= 2;
+  q->buf = malloc(q->size);
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  q->spill = q->spilltail = NULL;
+  return q->buf != NULL;
+}
+
+/* append h with its costs a[] and nodes b[], 0 if there is no room */
+static int ring_put(struct ring *q, const struct wirehdr *h, const int *a,
+                    const int *b)
+{
+  size_t len = reclen(h), skip = 0, pos, head, tail;
+  char *p;
+
+  head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  pos = head & (q->size - 1);
+  if (q->size - pos < len)
+    skip = q->size - pos;
+  if (head + skip + len - tail > q->size)
+    return 0;
+  if (skip >= sizeof(*h))
+    ((struct wirehdr *)(q->buf + pos))->type = W_PAD;
+  p = q->buf + ((head + skip) & (q->size - 1));
+  memcpy(p, h, sizeof(*h));
+  if (h->type == W_VECTOR) {
+    memcpy(p + sizeof(*h), a, h->arg[0] * sizeof(int));
+    if (h->arg[1])
+      memcpy(p + sizeof(*h) + h->arg[0] * sizeof(int), b,
+             h->arg[0] * sizeof(int));
+  }
+  atomic_store_explicit(&q->head, head + skip + len, memory_order_release);
+  return 1;
+}
+
+/* the oldest record in q, NULL if there is none; it stays there until
+   ring_next() */
+static struct wirehdr *ring_peek(struct ring *q)
+{
+  size_t tail, head, pos;
+  struct wirehdr *h;
+
+  tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  head = atomic_load_explicit(&q->head, memory_order_acquire);
+  while (tail != head) {
+    pos = tail & (q->size - 1);
+    if (q->size - pos >= sizeof(*h)) {
+      h = (struct wirehdr *)(q->buf + pos);
+      if (h->type != W_PAD)
+        return h;
+    }
+    tail += q->size - pos;
+    atomic_store_explicit(&q->tail, tail, memory_order_release);
+  }
+  return NULL;
+}
+
+static void ring_next(struct ring *q, const struct wirehdr *h)
+{
+  atomic_store_explicit(&q->tail, atomic_load_explicit(&q->tail,
+                        memory_order_relaxed) + reclen(h),
+                        memory_order_release);
+}
+
+/* put what waits in q's spill list into it, as far as there is room */
+static void ring_unspill(struct ring *q)
+{
+  struct spill *sp;
+
+  while ((sp = q->spill) != NULL &&
+         ring_put(q, &sp->h, sp->data, sp->data + sp->h.arg[0])) {
+    q->spill = sp->next;
+    free(sp);
+  }
+  if (q->spill == NULL)
+    q->spilltail = NULL;
+}
+
+/******************************** THREADS ********************************/
+
+struct shard {
+  int first, last;               /* its routers, [first, last) */
+  struct ring cmd;               /* W_LINK and W_QUIT from the controller */
+  struct netcounts final;        /* once it has stopped */
+  pthread_t thread;
+  /* published after every pass that did something */
+  _Alignas(64) _Atomic uint64_t sent;
+  _Atomic uint64_t handled;
+  _Atomic double lastmove;       /* nowms() at the end of that pass */
+};
+
+static struct router *routers;   /* -j: all of them */
+static struct shard *shards;
+static struct ring *rings;       /* per edge of topo, its sender to its
+                                    receiver */
+static int *rev;                 /* per edge, the edge the other way */
+static pthread_barrier_t startbarrier;
+static double tstart;            /* when the routers were started */
+static __thread int nspilled;    /* packets in this thread's spill lists */
+
+static void ringsend(struct rtpkt *packet, int edge)
+{
+  struct ring *q = &rings[edge];
+  struct wirehdr h;
+  struct spill *sp;
+  size_t n = packet->nentries;
+
+  h.type = W_VECTOR;
+  h.sourceid = packet->sourceid;
+  h.destid = packet->destid;
+  h.arg[0] = packet->nentries;
+  h.arg[1] = packet->dest != NULL;
+  cnt.sent++;
+  cnt.bytes += reclen(&h);
+  if (q->spill == NULL && ring_put(q, &h, packet->mincost, packet->dest))
+    return;
+  sp = malloc(sizeof(*sp) + (h.arg[1] ? 2 : 1) * n * sizeof(int));
+  if (sp == NULL) {
+    printf("dvnet: out of memory for a packet\n");
+    exit(1);
+  }
+  sp->next = NULL;
+  sp->h = h;
+  memcpy(sp->data, packet->mincost, n * sizeof(int));
+  if (h.arg[1])
+    memcpy(sp->data + n, packet->dest, n * sizeof(int));
+  if (q->spilltail != NULL)
+    q->spilltail->next = sp;
+  else
+    q->spill = sp;
+  q->spilltail = sp;
+  cnt.waited++;
+  nspilled++;
+}
+
+static void *shardmain(void *arg)
+{
+  struct shard *sh = arg;
+  struct wirehdr *h;
+  struct event *p;
+  struct rtpkt pkt;
+  struct ring *q;
+  struct spill *sp;
+  struct timespec nap = { 0, 50000 };
+  double pass;
+  int i, e, busy, idle = 0, quit = 0;
+
+  timers = evq_create("heap");
+  newwheel();
+  pthread_barrier_wait(&startbarrier);
+  t0 = tstart;
+  for (i = sh->first; i < sh->last; i++)
+    rtinit(&routers[i], i);
+  while (!quit) {
+    busy = 0;
+    pass = threadcpu();
+    while ((h = ring_peek(&sh->cmd)) != NULL) {
+      if (h->type == W_LINK)
+        linkhandler(&routers[h->destid], h->arg[0], h->arg[1]);
+      else if (h->type == W_QUIT)
+        quit = 1;
+      ring_next(&sh->cmd, h);
+      busy = 1;
+    }
+    while ((p = evq_peek(timers)) != NULL && p->evtime <= nowms() - t0) {
+      evq_pop(timers);
+      rttimer(&routers[p->eventity], p->linkid);
+      free(p);
+      busy = 1;
+    }
+    if (firewheel(routers, 0) > 0)
+      busy = 1;
+    for (i = sh->first; i < sh->last; i++)
+      for (e = topo->rowstart[i]; e < topo->rowstart[i + 1]; e++) {
+        q = &rings[rev[e]];
+        while ((h = ring_peek(q)) != NULL) {
+          pkt.sourceid = h->sourceid;
+          pkt.destid = h->destid;
+          pkt.nentries = h->arg[0];
+          pkt.mincost = (int *)(h + 1);
+          pkt.dest = h->arg[1] ? pkt.mincost + pkt.nentries : NULL;
+          rtupdate(&routers[i], &pkt);
+          cnt.handled++;
+          ring_next(q, h);
+          busy = 1;
+        }
+      }
+    if (nspilled > 0) {
+      nspilled = 0;
+      for (i = sh->first; i < sh->last; i++)
+        for (e = topo->rowstart[i]; e < topo->rowstart[i + 1]; e++) {
+          q = &rings[e];
+          if (q->spill != NULL)
+            ring_unspill(q);
+          for (sp = q->spill; sp != NULL; sp = sp->next)
+            nspilled++;
+        }
+    }
+    if (busy) {
+      atomic_store_explicit(&sh->sent, cnt.sent, memory_order_relaxed);
+      atomic_store_explicit(&sh->handled, cnt.handled, memory_order_relaxed);
+      atomic_store_explicit(&sh->lastmove, nowms(), memory_order_release);
+      cnt.cpu += threadcpu() - pass;
+      idle = 0;
+    } else if (++idle < SPINS)
+      sched_yield();
+    else
+      nanosleep(&nap, NULL);
+  }
+  for (i = sh->first; i < sh->last; i++)
+    cnt.changed += routers[i].nchanged;
+  sh->final = cnt;
+  return NULL;
+}
+
+/* the controller's side */
+static void tellshard(int node, int type, int a, int b)
+{
+  struct shard *sh;
+  struct wirehdr h;
+
+  for (sh = shards; node >= sh->last; sh++)
+    ;
+  h.type = type;
+  h.sourceid = -1;
+  h.destid = node;
+  h.arg[0] = a;
+  h.arg[1] = b;
+  while (!ring_put(&sh->cmd, &h, NULL, NULL))
+    sched_yield();
+}
+
+static void startthreads(void)
+{
+  size_t maxrec, ringsize;
+  int i, e;
+
+  routers = calloc(nnodes, sizeof(struct router));
+  shards = aligned_alloc(64, nthreads * sizeof(struct shard));
+  rings = aligned_alloc(64, (topo->nedges ? topo->nedges : 1) *
+                            sizeof(struct ring));
+  rev = malloc((topo->nedges ? topo->nedges : 1) * sizeof(int));
+  if (routers == NULL || shards == NULL || rings == NULL || rev == NULL) {
+    printf("dvnet: out of memory\n");
+    exit(1);
+  }
+  /* room for two of the largest packets at least, so one always fits
+     however the last one was placed */
+  maxrec = sizeof(struct wirehdr) + (deltaupdates ? 2 : 1) *
+           (size_t)nnodes * sizeof(int);
+  ringsize = RINGPKTS * maxrec;
+  if (topo->nedges > 0 && ringsize > (size_t)RINGBYTES / topo->nedges)
+    ringsize = (size_t)RINGBYTES / topo->nedges;
+  if (ringsize < 2 * maxrec)
+    ringsize = 2 * maxrec;
+  for (i = 0; i < nnodes; i++)
+    for (e = topo->rowstart[i]; e < topo->rowstart[i + 1]; e++) {
+      rev[e] = topo_edge(topo, topo->adj[e], i);
+      if (!ring_init(&rings[e], ringsize)) {
+        printf("dvnet: out of memory for the rings\n");
+        exit(1);
+      }
+    }
+  pthread_barrier_init(&startbarrier, NULL, nthreads + 1);
+  for (i = 0; i < nthreads; i++) {
+    memset(&shards[i], 0, sizeof(shards[i]));
+    shards[i].first = (int)((long long)i * nnodes / nthreads);
+    shards[i].last = (int)((long long)(i + 1) * nnodes / nthreads);
+    if (!ring_init(&shards[i].cmd, CMDRING)) {
+      printf("dvnet: out of memory\n");
+      exit(1);
+    }
+    pthread_create(&shards[i].thread, NULL, shardmain, &shards[i]);
+  }
+}
+
+/**************************** ROUTER PROCESS ****************************/
+
+static int sock;                 /* this router's */
+static struct router rt;
+static struct dgrams out, in;
+static int started, quit;
+
+/* send the datagrams queued in out */
+static void flush(void)
+{
+  int i = 0, n;
+
+  while (i < out.n) {
+    n = sendmmsg(sock, &out.msg[i], out.n - i, 0);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("dvnet: sendmmsg");
+      exit(1);
+    }
+    cnt.sendcalls++;
+    i += n;
+  }
+  out.n = 0;
+}
+
+/* the emulator's, for router.c: queue the packet for the next flush(),
+   or with -j put it in the link's ring */
+void tolayer2(struct rtpkt packet)
+{
+  struct wirehdr *h;
+  size_t len;
+  int k, edge;
+
+  edge = topo_edge(topo, packet.sourceid, packet.destid);
+  if (edge < 0) {
+    printf("WARNING: source and destination not connected, ignoring packet!\n");
+    return;
+  }
+  if (nthreads > 0) {
+    ringsend(&packet, edge);
+    return;
+  }
+  if (out.n == BATCH)
+    flush();
+  k = out.n++;
+  h = (struct wirehdr *)out.buf[k];
+  h->type = W_VECTOR;
+  h->sourceid = packet.sourceid;
+  h->destid = packet.destid;
+  h->arg[0] = packet.nentries;
+  h->arg[1] = packet.dest != NULL;
+  len = sizeof(*h);
+  memcpy(out.buf[k] + len, packet.mincost, packet.nentries * sizeof(int));
+  len += packet.nentries * sizeof(int);
+  if (packet.dest != NULL) {
+    memcpy(out.buf[k] + len, packet.dest, packet.nentries * sizeof(int));
+    len += packet.nentries * sizeof(int);
+  }
+  out.iov[k].iov_len = len;
+  out.msg[k].msg_hdr.msg_name = &addrs[packet.destid];
+  out.msg[k].msg_hdr.msg_namelen = sizeof(addrs[packet.destid]);
+  cnt.sent++;
+  cnt.bytes += len;
+}
+
+void creatertpkt(struct rtpkt *initrtpkt, int srcid, int destid, int *mincosts)
+{
+  initrtpkt->sourceid = srcid;
+  initrtpkt->destid = destid;
+  initrtpkt->mincost = mincosts;
+  initrtpkt->dest = NULL;
+  initrtpkt->nentries = nnodes;
+}
+
+void starttimer(int node, float delay, int arg)
+{
+  struct event *p;
+
+  p = calloc(1, sizeof(struct event));
+  if (p == NULL) {
+    printf("dvnet: out of memory for a timer\n");
+    exit(1);
+  }
+  p->evtime = nowms() - t0 + delay * unitms;
+  p->eventity = node;
+  p->linkid = arg;
+  evq_insert(timers, p);
+}
+
+static void begin(int id)
+{
+  t0 = nowms();
+  started = 1;
+  rtinit(&rt, id);
+}
+
+/* 1 if a datagram for router id is one it could have been sent: the
+   node numbers in it are below nnodes and it is exactly as long as its
+   header says.  Anything else on the port is dropped unread. */
+static int wellformed(int id, const struct wirehdr *h, size_t len)
+{
+  const int *dest;
+  int i;
+
+  if (len < sizeof(*h))
+    return 0;
+  switch (h->type) {
+    case W_VECTOR:
+      if (h->sourceid < 0 || h->sourceid >= nnodes || h->destid != id ||
+          h->arg[0] < 0 || h->arg[0] > nnodes ||
+          (h->arg[1] != 0 && h->arg[1] != 1) || len != reclen(h))
+        return 0;
+      if (h->arg[1]) {
+        dest = (const int *)(h + 1) + h->arg[0];
+        for (i = 0; i < h->arg[0]; i++)
+          if (dest[i] < 0 || dest[i] >= nnodes)
+            return 0;
+      }
+      return 1;
+    case W_LINK:
+      return h->arg[0] >= 0 && h->arg[0] < nnodes && len == sizeof(*h);
+    case W_START:
+    case W_QUIT:
+      return len == sizeof(*h);
+  }
+  return 0;
+}
+
+static void handle(int id, char *buf, size_t len)
+{
+  struct wirehdr *h = (struct wirehdr *)buf;
+  struct rtpkt pkt;
+
+  if (!wellformed(id, h, len))
+    return;
+  if (!started && h->type != W_QUIT)
+    begin(id);
+  switch (h->type) {
+    case W_VECTOR:
+      pkt.sourceid = h->sourceid;
+      pkt.destid = h->destid;
+      pkt.nentries = h->arg[0];
+      pkt.mincost = (int *)(h + 1);
+      pkt.dest = h->arg[1] ? pkt.mincost + pkt.nentries : NULL;
+      rtupdate(&rt, &pkt);
+      cnt.handled++;
+      break;
+    case W_LINK:
+      linkhandler(&rt, h->arg[0], h->arg[1]);
+      break;
+    case W_QUIT:
+      quit = 1;
+      break;
+  }
+}
+
+static void tocontroller(int type, const int *best)
+{
+  struct wirehdr *h = (struct wirehdr *)out.buf[0];
+  size_t len;
+
+  h->type = type;
+  h->sourceid = rt.id;
+  h->destid = -1;
+  h->arg[0] = best != NULL ? nnodes : 0;
+  h->arg[1] = 0;
+  cnt.when = nowms();
+  memcpy(h + 1, &cnt, sizeof(cnt));
+  len = sizeof(*h) + sizeof(cnt);
+  if (best != NULL) {
+    memcpy(out.buf[0] + len, best, nnodes * sizeof(int));
+    len += nnodes * sizeof(int);
+  }
+  if (sendto(sock, out.buf[0], len, 0, (struct sockaddr *)&addrs[nnodes],
+             sizeof(addrs[nnodes])) < 0)
+    perror("dvnet: sendto");
+}
+
+static void routerproc(int id)
+{
+  struct pollfd pfd;
+  struct event *p;
+  uint64_t lastsent = 0, lasthandled = 0, tick;
+  int i, n, timeout, wait;
+
+  dgrams_init(&out);
+  dgrams_init(&in);
+  timers = evq_create("heap");
+  newwheel();
+  sock = socks[id];
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  while (!quit) {
+    timeout = -1;
+    if ((p = evq_peek(timers)) != NULL) {
+      timeout = (int)(p->evtime - (nowms() - t0) + 1.0);
+      if (timeout < 0)
+        timeout = 0;
+    }
+    if (started && (tick = wheel_next(wheel)) != UINT64_MAX) {
+      wait = (int)((double)tick - (nowms() - t0) + 1.0);
+      if (wait < 0)
+        wait = 0;
+      if (timeout < 0 || wait < timeout)
+        timeout = wait;
+    }
+    if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+      perror("dvnet: poll");
+      exit(1);
+    }
+    while ((p = evq_peek(timers)) != NULL && p->evtime <= nowms() - t0) {
+      evq_pop(timers);
+      rttimer(&rt, p->linkid);
+      free(p);
+    }
+    if (started)
+      firewheel(&rt, id);
+    n = recvmmsg(sock, in.msg, BATCH, MSG_DONTWAIT, NULL);
+    if (n > 0) {
+      cnt.recvcalls++;
+      for (i = 0; i < n && !quit; i++)
+        handle(id, in.buf[i], in.msg[i].msg_len);
+    }
+    flush();
+    if (cnt.sent != lastsent || cnt.handled != lasthandled) {
+      lastsent = cnt.sent;
+      lasthandled = cnt.handled;
+      tocontroller(W_REPORT, NULL);
+    }
+  }
+  cnt.cpu = cputime();
+  cnt.changed = rt.nchanged;
+  tocontroller(W_FINAL, validate ? rt.best : NULL);
+  exit(0);
+}
+
+/****************************** CONTROLLER ******************************/
+
+struct phase {
+  double start;          /* ms after the routers started */
+  double last;           /* last time a count moved, start if never */
+  uint64_t sent;         /* packets sent during it */
+  int settled;
+};
+
+static struct netcounts *counts;    /* latest from each router */
+static struct phase *ph;
+static int nphases;
+
+/* counts moved at when, ms after the start, with dsent more packets
+   sent: put down to the phase they moved in */
+static void moved(double when, uint64_t dsent)
+{
+  int j;
+
+  for (j = nphases - 1; j > 0 && ph[j].start > when; j--)
+    ;
+  if (when > ph[j].last)
+    ph[j].last = when;
+  ph[j].sent += dsent;
+}
+
+/* take in everything the routers have sent.  Counts are put down to
+   the time the router reported them, not the time they are read: with
+   hundreds of busy routers the controller may not get to run for a
+   while. */
+static void collect(int ctl, struct dgrams *d, int **best, int *nfinal)
+{
+  struct wirehdr *h;
+  struct netcounts *c, *was;
+  int i, n;
+
+  while ((n = recvmmsg(ctl, d->msg, BATCH, MSG_DONTWAIT, NULL)) > 0)
+    for (i = 0; i < n; i++) {
+      h = (struct wirehdr *)d->buf[i];
+      if (d->msg[i].msg_len < sizeof(*h) + sizeof(struct netcounts) ||
+          h->sourceid < 0 || h->sourceid >= nnodes)
+        continue;
+      c = (struct netcounts *)(h + 1);
+      was = &counts[h->sourceid];
+      if (c->when < was->when)       /* overtaken by a later report */
+        continue;
+      if (c->sent != was->sent || c->handled != was->handled)
+        moved(c->when - tstart, c->sent - was->sent);
+      *was = *c;
+      if (h->type == W_FINAL) {
+        (*nfinal)++;
+        if (best != NULL && h->arg[0] == nnodes &&
+            d->msg[i].msg_len == sizeof(*h) + sizeof(*c) +
+                                 nnodes * sizeof(int))
+          memcpy(best[h->sourceid], c + 1, nnodes * sizeof(int));
+      }
+    }
+}
+
+/* -j: look at the threads' counts; 1 if every packet sent is handled */
+static int sample(uint64_t *sent, uint64_t *handled)
+{
+  uint64_t s = 0, h = 0;
+  double last = 0.0, t;
+  int i;
+
+  for (i = 0; i < nthreads; i++) {
+    t = atomic_load_explicit(&shards[i].lastmove, memory_order_acquire);
+    s += atomic_load_explicit(&shards[i].sent, memory_order_relaxed);
+    h += atomic_load_explicit(&shards[i].handled, memory_order_relaxed);
+    if (t > last)
+      last = t;
+  }
+  if (s != *sent || h != *handled)
+    moved(last - tstart, s - *sent);
+  *sent = s;
+  *handled = h;
+  return s == h;
+}
+
+static int checktables(int **best, const struct scenario *s)
+{
+  struct oraclestats st;
+  int *linkcost, i, n;
+
+  /* the links' costs once every change has been made */
+  linkcost = malloc((topo->nedges ? topo->nedges : 1) * sizeof(int));
+  if (linkcost == NULL) {
+    printf("dvnet: out of memory for the oracle\n");
+    exit(1);
+  }
+  memcpy(linkcost, topo->cost, topo->nedges * sizeof(int));
+  for (i = 0; i < s->nchanges; i++) {
+    linkcost[topo_edge(topo, s->changes[i].a, s->changes[i].b)] =
+      s->changes[i].cost;
+    linkcost[topo_edge(topo, s->changes[i].b, s->changes[i].a)] =
+      s->changes[i].cost;
+  }
+  n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  oracle_check(topo, linkcost, best, n, &st);
+  if (st.router < 0)
+    printf("oracle: all %d routers have the cheapest paths\n", nnodes);
+  else
+    printf("oracle: %ld costs wrong in %d of %d routers; first at router "
+           "%d, destination %d: %d in the table, %d by the cheapest path\n",
+           st.mismatches, st.routers, nnodes, st.router, st.dest, st.got,
+           st.want);
+  free(linkcost);
+  return st.router < 0;
+}
+
+static void tell(int ctl, int node, int type, int a, int b)
+{
+  if (nthreads > 0)
+    tellshard(node, type, a, b);
+  else
+    sendctl(ctl, node, type, a, b);
+}
+
+/* ctl is the controller's socket, unused with -j; 0 if -V found a
+   table wrong */
+static int controller(int ctl, const struct scenario *s)
+{
+  struct dgrams d;
+  struct netcounts sum;
+  struct pollfd pfd;
+  struct timespec nap;
+  uint64_t sent = 0, handled = 0;
+  int **best = NULL;
+  double now, wait, busy;
+  int i, k, next, nfinal = 0, drained = 1, ok = 1;
+
+  ph = calloc(s->nchanges + 1, sizeof(struct phase));
+  if (validate)
+    best = malloc(nnodes * sizeof(int *));
+  if (ph == NULL || (validate && best == NULL)) {
+    printf("dvnet: out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < nnodes && validate && nthreads == 0; i++)
+    if ((best[i] = malloc(nnodes * sizeof(int))) == NULL) {
+      printf("dvnet: out of memory for the routers' costs\n");
+      exit(1);
+    }
+  if (nthreads == 0) {
+    dgrams_init(&d);
+    pfd.fd = ctl;
+    pfd.events = POLLIN;
+  }
+
+  tstart = nowms();
+  if (nthreads > 0)
+    pthread_barrier_wait(&startbarrier);
+  else
+    for (i = 0; i < nnodes; i++)
+      sendctl(ctl, i, W_START, 0, 0);
+  nphases = 1;
+  next = 0;
+  while (1) {
+    now = nowms() - tstart;
+    /* changes at the same time make one phase */
+    while (next < s->nchanges && s->changes[next].time * unitms <= now) {
+      if (s->changes[next].time * unitms > ph[nphases - 1].start ||
+          nphases == 1) {
+        ph[nphases].start = ph[nphases].last = s->changes[next].time * unitms;
+        nphases++;
+      }
+      tell(ctl, s->changes[next].a, W_LINK, s->changes[next].b,
+           s->changes[next].cost);
+      tell(ctl, s->changes[next].b, W_LINK, s->changes[next].a,
+           s->changes[next].cost);
+      next++;
+    }
+    k = nphases - 1;
+    wait = ph[k].settled ? 1e9 : quietms - (now - ph[k].last);
+    if (next < s->nchanges && s->changes[next].time * unitms - now < wait)
+      wait = s->changes[next].time * unitms - now;
+    if (nthreads > 0) {
+      /* the threads' counts are in memory: look every millisecond */
+      if (wait > 1.0)
+        wait = 1.0;
+      nap.tv_sec = 0;
+      nap.tv_nsec = wait > 0.0 ? (long)(wait * 1e6) : 0;
+      nanosleep(&nap, NULL);
+      drained = sample(&sent, &handled);
+    } else {
+      if (poll(&pfd, 1, wait > 0.0 ? (int)wait + 1 : 0) < 0 &&
+          errno != EINTR) {
+        perror("dvnet: poll");
+        exit(1);
+      }
+      collect(ctl, &d, NULL, &nfinal);
+    }
+    now = nowms() - tstart;
+    if (now - ph[k].last >= quietms && now - ph[k].start >= quietms &&
+        drained) {
+      ph[k].settled = 1;
+      if (next == s->nchanges)
+        break;
+    }
+  }
+
+  for (i = 0; i < (nthreads > 0 ? nthreads : nnodes); i++)
+    tell(ctl, nthreads > 0 ? shards[i].first : i, W_QUIT, 0, 0);
+  if (nthreads > 0) {
+    for (i = 0; i < nthreads; i++) {
+      pthread_join(shards[i].thread, NULL);
+      counts[i] = shards[i].final;
+    }
+    for (i = 0; i < nnodes && validate; i++)
+      best[i] = routers[i].best;
+    nfinal = nnodes;
+  } else
+    while (nfinal < nnodes) {
+      if (poll(&pfd, 1, 10000) == 0) {
+        printf("dvnet: %d routers did not stop\n", nnodes - nfinal);
+        break;
+      }
+      collect(ctl, &d, best, &nfinal);
+    }
+
+  if (nthreads > 0)
+    printf("\n%d routers on %d threads", nnodes, nthreads);
+  else
+    printf("\n%d router processes", nnodes);
+  printf(", %.1f ms per unit of time, settled after %.0f ms quiet\n",
+         unitms, quietms);
+  busy = 0.0;
+  for (k = 0; k < nphases; k++) {
+    printf("converged %.3f ms after t=%.3f ms, %lu packets%s\n",
+           ph[k].last - ph[k].start, ph[k].start, (unsigned long)ph[k].sent,
+           ph[k].settled ? "" : " (still busy at the next change)");
+    busy += ph[k].last - ph[k].start;
+  }
+  memset(&sum, 0, sizeof(sum));
+  for (i = 0; i < (nthreads > 0 ? nthreads : nnodes); i++) {
+    sum.sent += counts[i].sent;
+    sum.handled += counts[i].handled;
+    sum.bytes += counts[i].bytes;
+    sum.sendcalls += counts[i].sendcalls;
+    sum.recvcalls += counts[i].recvcalls;
+    sum.waited += counts[i].waited;
+    sum.changed += counts[i].changed;
+    sum.cpu += counts[i].cpu;
+  }
+  printf("%lu packets sent, %lu received, %lu lost, %lu bytes\n",
+         (unsigned long)sum.sent, (unsigned long)sum.handled,
+         (unsigned long)(sum.sent - sum.handled), (unsigned long)sum.bytes);
+  if (nthreads > 0)
+    printf("%lu packets found their ring full and waited\n",
+           (unsigned long)sum.waited);
+  else
+    printf("%lu sendmmsg and %lu recvmmsg calls, %.1f and %.1f packets per "
+           "call\n", (unsigned long)sum.sendcalls,
+           (unsigned long)sum.recvcalls,
+           sum.sendcalls ? (double)sum.sent / sum.sendcalls : 0.0,
+           sum.recvcalls ? (double)sum.handled / sum.recvcalls : 0.0);
+  printf("%lu best-route changes, %.3f s %s, %.2f us per packet\n",
+         (unsigned long)sum.changed, sum.cpu,
+         nthreads > 0 ? "of CPU in the threads' busy passes" :
+                        "of CPU in the routers",
+         sum.sent ? 1e6 * sum.cpu / sum.sent : 0.0);
+  printf("%.0f updates per second while settling\n",
+         busy > 0.0 ? sum.handled / (busy * 1e-3) : 0.0);
+  if (validate && nfinal == nnodes)
+    ok = checktables(best, s);
+  for (i = 0; i < nnodes && validate && nthreads == 0; i++)
+    free(best[i]);
+  free(best);
+  free(ph);
+  return ok;
+}
+
+/********************************* MAIN *********************************/
+
+/* a socket on 127.0.0.1 for every router and the controller, bound to
+   ports of the kernel's choosing before forking so all know them all */
+static void opensockets(void)
+{
+  socklen_t len;
+  int i, size = RCVBUF;
+
+  addrs = calloc(nnodes + 1, sizeof(struct sockaddr_in));
+  socks = malloc((nnodes + 1) * sizeof(int));
+  if (addrs == NULL || socks == NULL) {
+    printf("dvnet: out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i <= nnodes; i++) {
+    socks[i] = socket(AF_INET, SOCK_DGRAM, 0);
+    addrs[i].sin_family = AF_INET;
+    addrs[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    len = sizeof(addrs[i]);
+    if (socks[i] < 0 ||
+        bind(socks[i], (struct sockaddr *)&addrs[i], sizeof(addrs[i])) < 0 ||
+        getsockname(socks[i], (struct sockaddr *)&addrs[i], &len) < 0) {
+      perror("dvnet: socket");
+      exit(1);
+    }
+    setsockopt(socks[i], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+}
+
+/* path relative to the directory dvnet was started from, which is
+   where the files it comes with are; malloc'ed, never freed */
+static const char *besidebinary(const char *argv0, const char *path)
+{
+  char exe[4096], *slash, *p;
+  ssize_t n;
+
+  n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (n > 0)
+    exe[n] = '\0';
+  else
+    snprintf(exe, sizeof(exe), "%s", argv0);
+  slash = strrchr(exe, '/');
+  if (slash == NULL)
+    return path;
+  slash[1] = '\0';
+  p = malloc(strlen(exe) + strlen(path) + 1);
+  if (p == NULL)
+    return path;
+  strcpy(p, exe);
+  strcat(p, path);
+  return p;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-t topology] [-S scenario] "
+          "[-p legacy|bf|poison] [-d]\n"
+          "       [-H holddown] [-u ms] [-Q ms] [-j threads] [-T trace] "
+          "[-V]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const char *topofile = NULL, *scenariofile = NULL;
+  struct scenario *s;
+  pid_t *pids = NULL;
+  int c, i, j, status, failed, ok;
+
+  while ((c = getopt(argc, argv, "t:S:p:dH:u:Q:j:T:V")) != -1) {
+    switch (c) {
+      case 't': topofile = optarg; break;
+      case 'S': scenariofile = optarg; break;
+      case 'p':
+        if (strcmp(optarg, "legacy") == 0) rtpolicy = RT_LEGACY;
+        else if (strcmp(optarg, "bf") == 0) rtpolicy = RT_BELLMANFORD;
+        else if (strcmp(optarg, "poison") == 0) rtpolicy = RT_POISON;
+        else usage(argv[0]);
+        break;
+      case 'd': deltaupdates = 1; break;
+      case 'H': holddown = atof(optarg); break;
+      case 'u': unitms = atof(optarg); break;
+      case 'Q': quietms = atof(optarg); break;
+      case 'j':
+        if ((nthreads = atoi(optarg)) < 1)
+          usage(argv[0]);
+        break;
+      case 'T': TRACE = atoi(optarg); break;
+      case 'V': validate = 1; break;
+      default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || unitms <= 0.0 || quietms <= 0.0)
+    usage(argv[0]);
+  if (holddown > 0.0 && rtpolicy == RT_LEGACY) {
+    fprintf(stderr, "a hold-down (-H) needs costs that can go up, "
+            "-p bf or poison\n");
+    usage(argv[0]);
+  }
+  /* the assignment's network and changes unless told otherwise, as
+     distance_vector does, from the files next to dvnet */
+  if (topofile == NULL) {
+    topofile = besidebinary(argv[0], "topologies/assignment.topo");
+    if (scenariofile == NULL)
+      scenariofile = besidebinary(argv[0], "scenarios/assignment.scn");
+  }
+  if ((topo = topo_load(topofile)) == NULL)
+    return 1;
+  nnodes = topo->nnodes;
+  if (nthreads > nnodes)
+    nthreads = nnodes;
+  if (nthreads == 0 && sizeof(struct wirehdr) + sizeof(struct netcounts) +
+      2 * (size_t)nnodes * sizeof(int) > MAXDGRAM) {
+    printf("dvnet: a vector of %d nodes does not fit in a datagram, "
+           "use -j\n", nnodes);
+    return 1;
+  }
+  s = scenariofile != NULL ? scenario_load(scenariofile, topo)
+                           : scenario_fromchanges(0, NULL);
+  if (s == NULL)
+    return 1;
+  counts = calloc(nnodes, sizeof(struct netcounts));
+  if (counts == NULL) {
+    printf("dvnet: out of memory\n");
+    return 1;
+  }
+  failed = 0;
+  if (nthreads > 0) {
+    startthreads();
+    ok = controller(-1, s);
+  } else {
+    pids = malloc(nnodes * sizeof(pid_t));
+    if (pids == NULL) {
+      printf("dvnet: out of memory\n");
+      return 1;
+    }
+    opensockets();
+    fflush(stdout);
+    for (i = 0; i < nnodes; i++) {
+      pids[i] = fork();
+      if (pids[i] < 0) {
+        perror("dvnet: fork");
+        for (j = 0; j < i; j++)
+          kill(pids[j], SIGKILL);
+        return 1;
+      }
+      if (pids[i] == 0) {
+        for (j = 0; j <= nnodes; j++)
+          if (j != i)
+            close(socks[j]);
+        routerproc(i);
+      }
+    }
+    ok = controller(socks[nnodes], s);
+    for (i = 0; i < nnodes; i++)
+      if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != 0)
+        failed++;
+    if (failed > 0)
+      printf("dvnet: %d router processes failed\n", failed);
+  }
+  free(pids);
+  free(counts);
+  scenario_free(s);
+  topo_free(topo);
+  return failed > 0 || !ok;
+}
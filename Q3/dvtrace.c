@@ -0,0 +1,208 @@
+/* ******************************************************************
+ dvtrace: decode a binary trace written by distance_vector -B.
+
+   dvtrace trace.bin              the events as text, like TRACE=2
+   dvtrace -c trace.bin > t.json  Chrome trace JSON, for Perfetto
+
+ In the JSON every router is a thread; a packet is a slice on its
+ sender's track from when it was sent until it arrives, with a flow
+ arrow to its delivery on the receiver's track.  One unit of simulated
+ time is shown as one millisecond.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static struct tracerec *recs;
+static long nrecs;
+
+static int load(const char *path, struct tracehdr *h)
+{
+  FILE *f;
+  long cap;
+  size_t got;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return 0;
+  }
+  if (fread(h, sizeof(*h), 1, f) != 1 || h->magic != TRACE_MAGIC ||
+      h->version != TRACE_VERSION) {
+    fprintf(stderr, "%s: not a version %d trace\n", path, TRACE_VERSION);
+    fclose(f);
+    return 0;
+  }
+  cap = 0;
+  nrecs = 0;
+  do {
+    if (nrecs == cap) {
+      cap = cap ? 2 * cap : TRACE_BUFRECS;
+      recs = realloc(recs, cap * sizeof(struct tracerec));
+      if (recs == NULL) {
+        fprintf(stderr, "out of memory reading %s\n", path);
+        exit(1);
+      }
+    }
+    got = fread(&recs[nrecs], sizeof(struct tracerec), cap - nrecs, f);
+    nrecs += got;
+  } while (got > 0);
+  fclose(f);
+  return 1;
+}
+
+/* the records in time order.  Those of each lp already are, so they
+   are split into one stream per lp and merged; at the same time the
+   lower lp goes first, and records of one lp keep the order they were
+   made in. */
+static void merge(int nlps)
+{
+  struct tracerec *out;
+  long *start, *head, *end, i;
+  int lp, best;
+
+  out = malloc((nrecs ? nrecs : 1) * sizeof(struct tracerec));
+  start = calloc(nlps + 1, sizeof(long));
+  head = malloc(nlps * sizeof(long));
+  end = malloc(nlps * sizeof(long));
+  if (out == NULL || start == NULL || head == NULL || end == NULL) {
+    fprintf(stderr, "out of memory sorting the trace\n");
+    exit(1);
+  }
+  for (i = 0; i < nrecs; i++)
+    start[recs[i].lp < nlps ? recs[i].lp + 1 : nlps]++;
+  for (lp = 0; lp < nlps; lp++) {
+    start[lp + 1] += start[lp];
+    head[lp] = end[lp] = start[lp];
+  }
+  for (i = 0; i < nrecs; i++) {             /* split, keeping the order */
+    lp = recs[i].lp < nlps ? recs[i].lp : nlps - 1;
+    out[end[lp]++] = recs[i];
+  }
+  for (i = 0; i < nrecs; i++) {
+    best = -1;
+    for (lp = 0; lp < nlps; lp++)
+      if (head[lp] < end[lp] &&
+          (best < 0 || out[head[lp]].time < out[head[best]].time))
+        best = lp;
+    recs[i] = out[head[best]++];
+  }
+  free(out);
+  free(start);
+  free(head);
+  free(end);
+}
+
+static void text(void)
+{
+  struct tracerec *t;
+  long i;
+
+  for (i = 0; i < nrecs; i++) {
+    t = &recs[i];
+    switch (t->type) {
+    case TR_RECV:
+      printf("MAIN: rcv event, t=%.3f, at %d src:%2d, dest:%2d, entries: %d\n",
+             t->time, t->node, t->peer, t->node, t->value);
+      break;
+    case TR_SEND:
+      printf("    TOLAYER2: source: %d, dest: %d, entries: %d, "
+             "arrives at t=%.3f\n", t->node, t->peer, t->value, t->arrival);
+      break;
+    case TR_LINK:
+      printf("MAIN: rcv event, t=%.3f, at %d\n", t->time, t->node);
+      printf("\nlinkhandler%d: Link cost between node %d and %d changed to %d\n",
+             t->node, t->node, t->peer, t->value);
+      break;
+    case TR_TIMER:
+      printf("MAIN: rcv event, t=%.3f, at %d\n", t->time, t->node);
+      printf("\nrttimer%d: timer %d ran out\n", t->node, t->peer);
+      break;
+    case TR_DROP:
+      printf("    TOLAYER2: source: %d, dest: %d, entries: %d, dropped\n",
+             t->node, t->peer, t->value);
+      break;
+    }
+  }
+}
+
+static void chrome(const struct tracehdr *h)
+{
+  struct tracerec *t;
+  long i, flow;
+  int n;
+
+  printf("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  printf("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, "
+         "\"args\": {\"name\": \"%d routers, %d lps\"}}", h->nnodes, h->nlps);
+  for (n = 0; n < h->nnodes; n++)
+    printf(",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+           "\"tid\": %d, \"args\": {\"name\": \"router %d\"}}", n, n);
+  flow = 0;
+  for (i = 0; i < nrecs; i++) {
+    t = &recs[i];
+    switch (t->type) {
+    case TR_SEND:
+      printf(",\n{\"name\": \"to %d\", \"cat\": \"packet\", \"ph\": \"X\", "
+             "\"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+             "\"args\": {\"entries\": %d}}", t->peer, t->node,
+             t->time * 1000.0, (t->arrival - t->time) * 1000.0, t->value);
+      printf(",\n{\"name\": \"packet\", \"cat\": \"packet\", \"ph\": \"s\", "
+             "\"id\": %ld, \"pid\": 0, \"tid\": %d, \"ts\": %.3f}",
+             flow, t->node, t->time * 1000.0);
+      printf(",\n{\"name\": \"packet\", \"cat\": \"packet\", \"ph\": \"f\", "
+             "\"bp\": \"e\", \"id\": %ld, \"pid\": 0, \"tid\": %d, "
+             "\"ts\": %.3f}", flow, t->peer, t->arrival * 1000.0);
+      flow++;
+      break;
+    case TR_RECV:
+      printf(",\n{\"name\": \"from %d\", \"cat\": \"update\", \"ph\": \"i\", "
+             "\"s\": \"t\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, "
+             "\"args\": {\"entries\": %d}}", t->peer, t->node,
+             t->time * 1000.0, t->value);
+      break;
+    case TR_LINK:
+      printf(",\n{\"name\": \"link to %d costs %d\", \"cat\": \"link\", "
+             "\"ph\": \"i\", \"s\": \"p\", \"pid\": 0, \"tid\": %d, "
+             "\"ts\": %.3f}", t->peer, t->value, t->node, t->time * 1000.0);
+      break;
+    case TR_TIMER:
+      printf(",\n{\"name\": \"timer %d\", \"cat\": \"timer\", \"ph\": \"i\", "
+             "\"s\": \"t\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f}",
+             t->peer, t->node, t->time * 1000.0);
+      break;
+    case TR_DROP:
+      printf(",\n{\"name\": \"to %d dropped\", \"cat\": \"packet\", "
+             "\"ph\": \"i\", \"s\": \"t\", \"pid\": 0, \"tid\": %d, "
+             "\"ts\": %.3f, \"args\": {\"entries\": %d}}", t->peer, t->node,
+             t->time * 1000.0, t->value);
+      break;
+    }
+  }
+  printf("\n]}\n");
+}
+
+int main(int argc, char **argv)
+{
+  struct tracehdr h;
+  int json = 0;
+
+  if (argc == 3 && strcmp(argv[1], "-c") == 0)
+    json = 1;
+  else if (argc != 2) {
+    fprintf(stderr, "usage: %s [-c] trace.bin\n", argv[0]);
+    return 1;
+  }
+  if (!load(argv[argc - 1], &h))
+    return 1;
+  if (h.nlps > 1)
+    merge(h.nlps);
+  if (json)
+    chrome(&h);
+  else
+    text();
+  free(recs);
+  return 0;
+}
@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "distance_vector.h"
+#include "evqueue.h"
+
+#define HEAP_INITCAP        64
+#define CALQ_MINBUCKETS     16
+#define CALQ_SAMPLE         25
+
+struct evq_ops {
+  const char *name;
+  void (*insert)(struct evqueue *, struct event *);
+  struct event *(*pop)(struct evqueue *);
+  struct event *(*peek)(struct evqueue *);
+  void (*foreach)(struct evqueue *, void (*)(struct event *, void *), void *);
+  void (*destroy)(struct evqueue *);
+};
+
+struct evqueue {
+  const struct evq_ops *ops;
+  int size;
+  unsigned long seq;          /* next insertion number */
+
+  /* list */
+  struct event *head;
+
+  /* heap and dheap */
+  struct event **heap;
+  int cap;
+  int arity;
+
+  /* calendar */
+  struct event **bucket;      /* each bucket sorted, linked through next */
+  int nbucket;
+  double width;               /* simulated time covered by one bucket */
+  long long curday;           /* day (time/width) of the last dequeue */
+  int resizing;
+};
+
+/* true if a must be dequeued before b */
+static int ev_before(const struct event *a, const struct event *b)
+{
+  if (a->evtime != b->evtime)
+    return a->evtime < b->evtime;
+  return a->evseq > b->evseq;
+}
+
+/***************************** sorted list ******************************/
+
+static void list_insert(struct evqueue *q, struct event *p)
+{
+  struct event *r, *rold;
+
+  r = q->head;
+  if (r == NULL) {                  /* list is empty */
+    q->head = p;
+    p->next = NULL;
+    p->prev = NULL;
+    return;
+  }
+  for (rold = r; r != NULL && ev_before(r, p); r = r->next)
+    rold = r;
+  if (r == NULL) {                  /* end of list */
+    rold->next = p;
+    p->prev = rold;
+    p->next = NULL;
+  }
+  else if (r == q->head) {          /* front of list */
+    p->next = q->head;
+    p->prev = NULL;
+    p->next->prev = p;
+    q->head = p;
+  }
+  else {                            /* middle of list */
+    p->next = r;
+    p->prev = r->prev;
+    r->prev->next = p;
+    r->prev = p;
+  }
+}
+
+static struct event *list_peek(struct evqueue *q)
+{
+  return q->head;
+}
+
+static struct event *list_pop(struct evqueue *q)
+{
+  struct event *p = q->head;
+
+  if (p == NULL)
+    return NULL;
+  q->head = p->next;
+  if (q->head != NULL)
+    q->head->prev = NULL;
+  return p;
+}
+
+static void list_foreach(struct evqueue *q, void (*fn)(struct event *, void *),
+                         void *arg)
+{
+  struct event *p, *next;
+
+  for (p = q->head; p != NULL; p = next) {
+    next = p->next;
+    fn(p, arg);
+  }
+}
+
+static void list_destroy(struct evqueue *q)
+{
+  (void)q;
+}
+
+/******************************* d-ary heap ******************************/
+
+static void heap_insert(struct evqueue *q, struct event *p)
+{
+  int i, parent;
+
+  if (q->size == q->cap) {
+    q->cap = q->cap ? 2 * q->cap : HEAP_INITCAP;
+    q->heap = realloc(q->heap, q->cap * sizeof(struct event *));
+    if (q->heap == NULL) {
+      printf("Panic: out of memory growing event heap\n");
+      exit(1);
+    }
+  }
+  i = q->size;
+  while (i > 0) {
+    parent = (i - 1) / q->arity;
+    if (!ev_before(p, q->heap[parent]))
+      break;
+    q->heap[i] = q->heap[parent];
+    i = parent;
+  }
+  q->heap[i] = p;
+}
+
+static struct event *heap_peek(struct evqueue *q)
+{
+  return q->size > 0 ? q->heap[0] : NULL;
+}
+
+static struct event *heap_pop(struct evqueue *q)
+{
+  struct event *top, *last;
+  int i, c, best, first, end, n;
+
+  if (q->size == 0)
+    return NULL;
+  top = q->heap[0];
+  n = q->size - 1;                  /* size once top is gone */
+  last = q->heap[n];
+  i = 0;
+  for (;;) {
+    first = q->arity * i + 1;
+    if (first >= n)
+      break;
+    end = first + q->arity;
+    if (end > n)
+      end = n;
+    best = first;
+    for (c = first + 1; c < end; c++)
+      if (ev_before(q->heap[c], q->heap[best]))
+        best = c;
+    if (!ev_before(q->heap[best], last))
+      break;
+    q->heap[i] = q->heap[best];
+    i = best;
+  }
+  q->heap[i] = last;
+  return top;
+}
+
+static void heap_foreach(struct evqueue *q, void (*fn)(struct event *, void *),
+                         void *arg)
+{
+  int i;
+
+  for (i = 0; i < q->size; i++)
+    fn(q->heap[i], arg);
+}
+
+static void heap_destroy(struct evqueue *q)
+{
+  free(q->heap);
+}
+
+/***************************** calendar queue ****************************/
+/* Events are hashed by day = floor(evtime/width) into nbucket buckets, one
+   "year" being nbucket days.  Dequeue walks the buckets from the current
+   day and takes the first bucket head that belongs to the day being
+   looked at; a year with nothing in it falls back to a direct search.
+   The bucket count doubles and halves with the queue size, and the width
+   is re-estimated from the spacing of the earliest events each time.    */
+
+static long long calq_day(const struct evqueue *q, const struct event *p)
+{
+  return (long long)floor((double)p->evtime / q->width);
+}
+
+static void calq_resize(struct evqueue *q, int nbucket);
+
+static void calq_link(struct evqueue *q, struct event *p)
+{
+  struct event **pp;
+  long long day;
+  int b;
+
+  day = calq_day(q, p);
+  b = (int)(((day % q->nbucket) + q->nbucket) % q->nbucket);
+  for (pp = &q->bucket[b]; *pp != NULL && ev_before(*pp, p); pp = &(*pp)->next)
+    ;
+  p->next = *pp;
+  *pp = p;
+  if (day < q->curday)
+    q->curday = day;
+}
+
+static void calq_insert(struct evqueue *q, struct event *p)
+{
+  calq_link(q, p);
+  if (!q->resizing && q->size + 1 > 2 * q->nbucket)
+    calq_resize(q, 2 * q->nbucket);
+}
+
+/* bucket holding the earliest event, or -1 when empty */
+static int calq_find(struct evqueue *q)
+{
+  struct event *h;
+  long long day;
+  int i, b, best;
+
+  for (i = 0; i < q->nbucket; i++) {
+    day = q->curday + i;
+    b = (int)(day % q->nbucket);
+    h = q->bucket[b];
+    if (h != NULL && calq_day(q, h) <= day) {
+      q->curday = day;
+      return b;
+    }
+  }
+  /* nothing within a year: search the bucket heads directly */
+  best = -1;
+  for (b = 0; b < q->nbucket; b++)
+    if (q->bucket[b] != NULL &&
+        (best < 0 || ev_before(q->bucket[b], q->bucket[best])))
+      best = b;
+  if (best >= 0)
+    q->curday = calq_day(q, q->bucket[best]);
+  return best;
+}
+
+static struct event *calq_peek(struct evqueue *q)
+{
+  int b;
+
+  if (q->size == 0)
+    return NULL;
+  b = calq_find(q);
+  return b < 0 ? NULL : q->bucket[b];
+}
+
+static struct event *calq_pop(struct evqueue *q)
+{
+  struct event *p;
+  int b;
+
+  if (q->size == 0)
+    return NULL;
+  b = calq_find(q);
+  p = q->bucket[b];
+  q->bucket[b] = p->next;
+  if (!q->resizing && q->nbucket > CALQ_MINBUCKETS &&
+      q->size - 1 < q->nbucket / 2) {
+    q->size--;
+    calq_resize(q, q->nbucket / 2);
+    q->size++;                      /* evq_pop does the real decrement */
+  }
+  return p;
+}
+
+static void calq_resize(struct evqueue *q, int nbucket)
+{
+  struct event *sample[CALQ_SAMPLE], *all, *p, *next;
+  double sep, avg, sum;
+  int n, i, b, cnt;
+
+  q->resizing = 1;
+
+  /* estimate the width from the spacing of the earliest events */
+  n = q->size < CALQ_SAMPLE ? q->size : CALQ_SAMPLE;
+  for (i = 0; i < n; i++)
+    sample[i] = calq_pop(q);
+  if (n > 1) {
+    avg = ((double)sample[n-1]->evtime - sample[0]->evtime) / (n - 1);
+    sum = 0.0;
+    cnt = 0;
+    for (i = 1; i < n; i++) {
+      sep = (double)sample[i]->evtime - sample[i-1]->evtime;
+      if (sep <= 2.0 * avg) {
+        sum += sep;
+        cnt++;
+      }
+    }
+    if (cnt > 0 && sum > 0.0)
+      q->width = 3.0 * sum / cnt;
+  }
+
+  /* unhook everything and rehash into the new bucket array */
+  all = NULL;
+  for (b = 0; b < q->nbucket; b++)
+    for (p = q->bucket[b]; p != NULL; p = next) {
+      next = p->next;
+      p->next = all;
+      all = p;
+    }
+  for (i = 0; i < n; i++) {
+    sample[i]->next = all;
+    all = sample[i];
+  }
+  free(q->bucket);
+  q->nbucket = nbucket;
+  q->bucket = calloc(nbucket, sizeof(struct event *));
+  if (q->bucket == NULL) {
+    printf("Panic: out of memory resizing calendar queue\n");
+    exit(1);
+  }
+  q->curday = n > 0 ? calq_day(q, sample[0]) : 0;
+  for (p = all; p != NULL; p = next) {
+    next = p->next;
+    calq_link(q, p);
+  }
+  q->resizing = 0;
+}
+
+static void calq_foreach(struct evqueue *q, void (*fn)(struct event *, void *),
+                         void *arg)
+{
+  struct event *p, *next;
+  int b;
+
+  for (b = 0; b < q->nbucket; b++)
+    for (p = q->bucket[b]; p != NULL; p = next) {
+      next = p->next;
+      fn(p, arg);
+    }
+}
+
+static void calq_destroy(struct evqueue *q)
+{
+  free(q->bucket);
+}
+
+/******************************** front end *****************************/
+
+static const struct evq_ops list_ops = {
+  "list", list_insert, list_pop, list_peek, list_foreach, list_destroy
+};
+static const struct evq_ops heap_ops = {
+  "heap", heap_insert, heap_pop, heap_peek, heap_foreach, heap_destroy
+};
+static const struct evq_ops dheap_ops = {
+  "dheap", heap_insert, heap_pop, heap_peek, heap_foreach, heap_destroy
+};
+static const struct evq_ops calq_ops = {
+  "calendar", calq_insert, calq_pop, calq_peek, calq_foreach, calq_destroy
+};
+
+struct evqueue *evq_create(const char *spec)
+{
+  struct evqueue *q;
+  const char *arg;
+  size_t len;
+
+  q = calloc(1, sizeof(struct evqueue));
+  if (q == NULL)
+    return NULL;
+  arg = strchr(spec, ':');
+  len = arg ? (size_t)(arg - spec) : strlen(spec);
+
+  if (len == 4 && strncmp(spec, "list", len) == 0 && !arg)
+    q->ops = &list_ops;
+  else if (len == 4 && strncmp(spec, "heap", len) == 0 && !arg) {
+    q->ops = &heap_ops;
+    q->arity = 2;
+  }
+  else if (len == 5 && strncmp(spec, "dheap", len) == 0) {
+    q->ops = &dheap_ops;
+    q->arity = arg ? atoi(arg + 1) : 4;
+    if (q->arity < 2) {
+      free(q);
+      return NULL;
+    }
+  }
+  else if (len == 8 && strncmp(spec, "calendar", len) == 0 && !arg) {
+    q->ops = &calq_ops;
+    q->nbucket = CALQ_MINBUCKETS;
+    q->width = 1.0;
+    q->bucket = calloc(q->nbucket, sizeof(struct event *));
+    if (q->bucket == NULL) {
+      free(q);
+      return NULL;
+    }
+  }
+  else {
+    free(q);
+    return NULL;
+  }
+  return q;
+}
+
+void evq_destroy(struct evqueue *q)
+{
+  q->ops->destroy(q);
+  free(q);
+}
+
+const char *evq_name(const struct evqueue *q)
+{
+  return q->ops->name;
+}
+
+void evq_insert(struct evqueue *q, struct event *p)
+{
+  p->evseq = q->seq++;
+  q->ops->insert(q, p);
+  q->size++;
+}
+
+void evq_insertkeyed(struct evqueue *q, struct event *p)
+{
+  q->ops->insert(q, p);
+  q->size++;
+}
+
+struct event *evq_pop(struct evqueue *q)
+{
+  struct event *p = q->ops->pop(q);
+
+  if (p != NULL)
+    q->size--;
+  return p;
+}
+
+struct event *evq_peek(struct evqueue *q)
+{
+  return q->ops->peek(q);
+}
+
+int evq_size(const struct evqueue *q)
+{
+  return q->size;
+}
+
+void evq_foreach(struct evqueue *q, void (*fn)(struct event *, void *),
+                 void *arg)
+{
+  q->ops->foreach(q, fn, arg);
+}
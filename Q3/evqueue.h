@@ -0,0 +1,36 @@
+/* ******************************************************************
+ Pending-event queue used by the emulator's scheduler.
+
+ The queue hands events back in increasing evtime order.  Events with
+ the same evtime come out newest first, which is the order the original
+ sorted event list produced, so every backend replays a run identically.
+
+ Backends, selected by name when the queue is created:
+   list         the original sorted doubly-linked list, O(n) insert
+   heap         binary heap, O(log n) insert and remove
+   dheap[:d]    d-ary heap (default d=4), shallower than a binary heap
+   calendar     calendar queue (R. Brown, CACM 1988), O(1) expected
+**********************************************************************/
+#ifndef EVQUEUE_H
+#define EVQUEUE_H
+
+struct event;
+struct evqueue;
+
+struct evqueue *evq_create(const char *spec);   /* NULL if spec unknown */
+void evq_destroy(struct evqueue *q);
+const char *evq_name(const struct evqueue *q);
+
+void evq_insert(struct evqueue *q, struct event *p);
+/* as evq_insert, but ties are broken by the evseq the caller set in p,
+   larger first, instead of by insertion order */
+void evq_insertkeyed(struct evqueue *q, struct event *p);
+struct event *evq_pop(struct evqueue *q);        /* NULL when empty */
+struct event *evq_peek(struct evqueue *q);       /* NULL when empty */
+int evq_size(const struct evqueue *q);
+
+/* visit every pending event; the order is backend specific */
+void evq_foreach(struct evqueue *q, void (*fn)(struct event *, void *),
+                 void *arg);
+
+#endif
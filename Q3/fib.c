@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fib.h"
+#include "oracle.h"
+#include "router.h"
+#include "topology.h"
+#include "rng.h"
+
+#define DP_BATCH    32            /* packets moved a hop per pass */
+#define DP_CHUNK    65536         /* packets made at once */
+
+enum { DP_MOVING, DP_DELIVERED, DP_LOOPED, DP_DROPPED };
+
+struct dppkt {
+  int src, dst;
+  int at;                         /* node the packet is at */
+  int hops;
+  int cost;                       /* of the path so far */
+  int state;
+};
+
+struct fib *fib_create(const struct topology *t)
+{
+  struct fib *f;
+  size_t n = t->nnodes;
+  int i, e;
+
+  f = calloc(1, sizeof(struct fib));
+  if (f == NULL)
+    return NULL;
+  f->topo = t;
+  f->nnodes = t->nnodes;
+  f->e = malloc(n * n * sizeof(struct fibentry));
+  f->linkcost = malloc((t->nedges ? t->nedges : 1) * sizeof(int));
+  f->rev = malloc((t->nedges ? t->nedges : 1) * sizeof(int));
+  f->pathcost = calloc(t->nedges ? t->nedges : 1, sizeof(int));
+  f->dist = malloc(n * n * sizeof(int));
+  f->known = calloc(n ? n : 1, 1);
+  if (f->e == NULL || f->linkcost == NULL || f->rev == NULL ||
+      f->pathcost == NULL || f->dist == NULL || f->known == NULL ||
+      !spwork_init(&f->sp, t)) {
+    fib_free(f);
+    return NULL;
+  }
+  for (i = 0; i < t->nnodes; i++)
+    for (e = t->rowstart[i]; e < t->rowstart[i + 1]; e++)
+      f->rev[e] = topo_edge(t, t->adj[e], i);
+  return f;
+}
+
+void fib_free(struct fib *f)
+{
+  free(f->e);
+  free(f->linkcost);
+  free(f->rev);
+  free(f->pathcost);
+  free(f->dist);
+  free(f->known);
+  spwork_free(&f->sp);
+  free(f);
+}
+
+void fib_write(const struct fib *f, FILE *fp)
+{
+  const struct fibentry *e;
+  int i, j;
+
+  fprintf(fp, "# router dest nexthop cost, nexthop -1 where there is no "
+          "route\n");
+  for (i = 0; i < f->nnodes; i++)
+    for (j = 0; j < f->nnodes; j++) {
+      e = &f->e[(size_t)i * f->nnodes + j];
+      fprintf(fp, "%d %d %d %d\n", i, j, e->nexthop, e->cost);
+    }
+}
+
+/***************************** cheapest paths *****************************/
+
+/* dist[dest * nnodes + src] for every src: the paths to dest, leaving
+   out links that are down */
+static void cheapest(struct fib *f, int dest)
+{
+  oracle_paths(f->topo, f->pathcost, f->rev, dest,
+               &f->dist[(size_t)dest * f->nnodes], &f->sp);
+  f->known[dest] = 1;
+}
+
+/******************************** forwarding ******************************/
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* move every packet of the batch a hop per pass until none is moving;
+   live[] holds the ones still moving, so finished packets cost nothing */
+static void forwardbatch(const struct fib *f, struct dppkt *p, int n)
+{
+  const struct fibentry *e;
+  struct dppkt *q;
+  size_t nn = f->nnodes;
+  int live[DP_BATCH], nlive, i;
+
+  for (i = 0; i < n; i++)
+    live[i] = i;
+  nlive = n;
+  while (nlive > 0)
+    for (i = 0; i < nlive; ) {
+      q = &p[live[i]];
+      e = &f->e[q->at * nn + q->dst];
+      if (e->nexthop < 0 || e->cost >= INFINITY)
+        q->state = DP_DROPPED;
+      else {
+        q->at = e->nexthop;
+        q->cost += e->cost;
+        q->hops++;
+        if (q->at == q->dst)
+          q->state = DP_DELIVERED;
+        else if (q->hops >= f->nnodes)
+          q->state = DP_LOOPED;
+        else {
+          __builtin_prefetch(&f->e[q->at * nn + q->dst]);
+          i++;
+          continue;
+        }
+      }
+      live[i] = live[--nlive];
+    }
+}
+
+void fib_forward(struct fib *f, long n, uint64_t *rng, struct dpstats *st)
+{
+  struct dppkt *p;
+  double t0, s;
+  long done;
+  int i, m, best;
+
+  if (f->nnodes < 2)
+    return;
+  if (memcmp(f->pathcost, f->linkcost,
+             f->topo->nedges * sizeof(int)) != 0) {
+    memcpy(f->pathcost, f->linkcost, f->topo->nedges * sizeof(int));
+    memset(f->known, 0, f->nnodes);
+  }
+  p = malloc(DP_CHUNK * sizeof(struct dppkt));
+  if (p == NULL) {
+    printf("Panic: out of memory for data plane packets\n");
+    exit(1);
+  }
+  for (done = 0; done < n; done += m) {
+    m = n - done < DP_CHUNK ? (int)(n - done) : DP_CHUNK;
+    for (i = 0; i < m; i++) {
+      p[i].src = (int)(splitmix64(rng) % f->nnodes);
+      p[i].dst = (int)(splitmix64(rng) % (f->nnodes - 1));
+      if (p[i].dst >= p[i].src)
+        p[i].dst++;
+      p[i].at = p[i].src;
+      p[i].hops = 0;
+      p[i].cost = 0;
+      p[i].state = DP_MOVING;
+    }
+    t0 = now();
+    for (i = 0; i < m; i += DP_BATCH)
+      forwardbatch(f, &p[i], m - i < DP_BATCH ? m - i : DP_BATCH);
+    st->seconds += now() - t0;
+
+    for (i = 0; i < m; i++) {
+      st->hops += p[i].hops;
+      if (p[i].state == DP_LOOPED)
+        st->looped++;
+      else if (p[i].state == DP_DROPPED)
+        st->dropped++;
+      else {
+        st->delivered++;
+        if (!f->known[p[i].dst])
+          cheapest(f, p[i].dst);
+        best = f->dist[(size_t)p[i].dst * f->nnodes + p[i].src];
+        s = best > 0 ? (double)p[i].cost / best : 1.0;
+        st->stretch += s;
+        if (s > st->maxstretch)
+          st->maxstretch = s;
+        if (p[i].cost > best)
+          st->stretched++;
+      }
+    }
+    st->packets += m;
+  }
+  free(p);
+}
@@ -0,0 +1,67 @@
+/* ******************************************************************
+ Forwarding tables, and a data plane that pushes packets through them.
+
+ Every router compiles a FIB from its distance table (rtfib()): for each
+ destination, the neighbor a packet is handed to and what the link to
+ it costs.  The FIBs of all routers sit in one flat array, so taking a
+ packet one hop further is a single 8-byte load.
+
+ fib_forward() sends synthetic packets between random pairs of nodes.
+ They go in batches: every packet of a batch moves one hop per pass, so
+ the loads of different packets overlap instead of each one waiting on
+ the last.  A packet is delivered, dropped where there is no route or
+ the next link is down, or caught in a loop once it has taken as many
+ hops as there are nodes.  A delivered packet's path cost is compared
+ with the cheapest path over the links' current costs, found with
+ oracle_paths(), for the stretch.
+**********************************************************************/
+#ifndef FIB_H
+#define FIB_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "oracle.h"
+
+struct topology;
+
+struct fibentry {
+  int32_t nexthop;       /* -1: no route */
+  int32_t cost;          /* of the link to nexthop */
+};
+
+struct fib {
+  const struct topology *topo;
+  int nnodes;
+  struct fibentry *e;    /* e[router * nnodes + dest] */
+  int *linkcost;         /* current cost of every edge of topo, set by
+                            whoever fills in e[] */
+  /* the cheapest paths, worked out as they are needed */
+  int *rev;              /* the edge the other way */
+  int *pathcost;         /* the costs dist[] is for */
+  int *dist;             /* dist[dest * nnodes + src] */
+  char *known;           /* per dest, dist[] is filled in */
+  struct spwork sp;
+};
+
+struct dpstats {
+  unsigned long packets;
+  unsigned long delivered;
+  unsigned long looped;      /* as many hops as nodes, and still going */
+  unsigned long dropped;     /* no route, or the next link is down */
+  unsigned long hops;
+  unsigned long stretched;   /* delivered over a path costlier than best */
+  double stretch;            /* summed over the delivered packets */
+  double maxstretch;
+  double seconds;            /* spent forwarding */
+};
+
+struct fib *fib_create(const struct topology *t);   /* NULL if no memory */
+void fib_free(struct fib *f);
+/* "router dest nexthop cost" lines */
+void fib_write(const struct fib *f, FILE *fp);
+/* send n packets, between pairs of distinct nodes drawn from *rng, and
+   add up what happened to them in st */
+void fib_forward(struct fib *f, long n, uint64_t *rng, struct dpstats *st);
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "oracle.h"
+#include "router.h"
+#include "topology.h"
+
+#define NBUCKETS    INFINITY      /* usable costs are 0 .. INFINITY-1 */
+
+int spwork_init(struct spwork *w, const struct topology *t)
+{
+  w->head = malloc(NBUCKETS * sizeof(int));
+  w->e = malloc((t->nedges + 1) * sizeof(struct spentry));
+  if (w->head == NULL || w->e == NULL) {
+    spwork_free(w);
+    return 0;
+  }
+  return 1;
+}
+
+void spwork_free(struct spwork *w)
+{
+  free(w->head);
+  free(w->e);
+  w->head = NULL;
+  w->e = NULL;
+}
+
+/* A node goes into the bucket of its distance each time that distance
+   drops, so there are at most as many entries as edges plus the root;
+   entries whose distance is no longer the node's are skipped.  Every
+   cost is less than NBUCKETS, so the buckets ahead of the current one
+   never wrap around onto it. */
+void oracle_paths(const struct topology *t, const int *edgecost,
+                  const int *rev, int root, int *dist, struct spwork *w)
+{
+  struct spentry *en = w->e;
+  int *head = w->head;
+  int i, e, b, nb, v, u, c, d, used, pending;
+
+  for (i = 0; i < t->nnodes; i++)
+    dist[i] = -1;                  /* not reached */
+  for (b = 0; b < NBUCKETS; b++)
+    head[b] = -1;
+  dist[root] = 0;
+  en[0].node = root;
+  en[0].dist = 0;
+  en[0].next = -1;
+  head[0] = 0;
+  used = pending = 1;
+  for (b = 0; pending > 0; b = b + 1 < NBUCKETS ? b + 1 : 0)
+    while ((i = head[b]) >= 0) {
+      head[b] = en[i].next;
+      pending--;
+      v = en[i].node;
+      if (en[i].dist != dist[v])
+        continue;
+      for (e = t->rowstart[v]; e < t->rowstart[v + 1]; e++) {
+        c = edgecost[rev != NULL ? rev[e] : e];
+        if (c >= INFINITY)
+          continue;
+        u = t->adj[e];
+        d = dist[v] + c;
+        if (dist[u] >= 0 && dist[u] <= d)
+          continue;
+        dist[u] = d;
+        nb = b + c < NBUCKETS ? b + c : b + c - NBUCKETS;
+        en[used].node = u;
+        en[used].dist = d;
+        en[used].next = head[nb];
+        head[nb] = used++;
+        pending++;
+      }
+    }
+  for (i = 0; i < t->nnodes; i++)
+    if (dist[i] < 0 || dist[i] > INFINITY)
+      dist[i] = INFINITY;
+}
+
+struct oraclejob {
+  const struct topology *t;
+  const int *edgecost;
+  int *const *best;
+  int next;                        /* next source to hand out */
+  pthread_mutex_t lock;
+  struct oraclestats *st;
+};
+
+static void *oracleworker(void *arg)
+{
+  struct oraclejob *job = arg;
+  const struct topology *t = job->t;
+  struct oraclestats *st = job->st;
+  struct spwork w;
+  int *dist, s, d, first, n;
+
+  dist = malloc((t->nnodes ? t->nnodes : 1) * sizeof(int));
+  if (dist == NULL || !spwork_init(&w, t)) {
+    printf("Panic: out of memory for the oracle\n");
+    exit(1);
+  }
+  while (1) {
+    pthread_mutex_lock(&job->lock);
+    s = job->next++;
+    pthread_mutex_unlock(&job->lock);
+    if (s >= t->nnodes)
+      break;
+    oracle_paths(t, job->edgecost, NULL, s, dist, &w);
+    first = -1;
+    n = 0;
+    for (d = 0; d < t->nnodes; d++)
+      if (job->best[s][d] != dist[d]) {
+        if (first < 0)
+          first = d;
+        n++;
+      }
+    if (n == 0)
+      continue;
+    pthread_mutex_lock(&job->lock);
+    st->mismatches += n;
+    st->routers++;
+    if (st->router < 0 || s < st->router) {
+      st->router = s;
+      st->dest = first;
+      st->got = job->best[s][first];
+      st->want = dist[first];
+    }
+    pthread_mutex_unlock(&job->lock);
+  }
+  spwork_free(&w);
+  free(dist);
+  return NULL;
+}
+
+void oracle_check(const struct topology *t, const int *edgecost,
+                  int *const *best, int nthreads, struct oraclestats *st)
+{
+  struct oraclejob job;
+  struct timespec t0, t1;
+  pthread_t *threads;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  st->mismatches = 0;
+  st->routers = 0;
+  st->router = st->dest = -1;
+  st->got = st->want = 0;
+  job.t = t;
+  job.edgecost = edgecost;
+  job.best = best;
+  job.next = 0;
+  job.st = st;
+  pthread_mutex_init(&job.lock, NULL);
+  if (nthreads < 1)
+    nthreads = 1;
+  threads = malloc(nthreads * sizeof(pthread_t));
+  for (i = 0; i < nthreads; i++)
+    pthread_create(&threads[i], NULL, oracleworker, &job);
+  for (i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  pthread_mutex_destroy(&job.lock);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  st->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
@@ -0,0 +1,55 @@
+/* ******************************************************************
+ The shortest-path oracle: what the routers' tables should say once the
+ network is quiet.  It runs Dijkstra from every node over the links'
+ current costs and compares the result with each router's minimum
+ costs.  Sources are shared out among threads; each thread needs only
+ one row of distances at a time, so memory is O(threads * nodes), not
+ nodes^2, and 100k-node networks are fine.
+
+ Link costs are small integers, so Dijkstra keeps its frontier in
+ buckets, one per distance modulo the largest cost (Dial's algorithm),
+ instead of a heap: every step is O(1) and a run is O(links + distance
+ of the farthest node).  A cost of INFINITY or more is a link that is
+ down, and distances of INFINITY or more count as unreachable, as they
+ do in the routers.
+**********************************************************************/
+#ifndef ORACLE_H
+#define ORACLE_H
+
+struct topology;
+
+/* what one run of oracle_paths() needs, reusable from run to run */
+struct spentry {
+  int node;              /* reached */
+  int dist;              /* at this distance */
+  int next;              /* entry after this one in its bucket, or -1 */
+};
+
+struct spwork {
+  int *head;             /* per bucket, first entry, -1 if empty */
+  struct spentry *e;     /* one per edge, plus the root */
+};
+
+int spwork_init(struct spwork *w, const struct topology *t);   /* 0: no memory */
+void spwork_free(struct spwork *w);
+
+/* dist[] from root to every node over edgecost[] (indexed like the
+   topology's adj[]); with rev[] (the index of each edge the other way)
+   the distances to root instead */
+void oracle_paths(const struct topology *t, const int *edgecost,
+                  const int *rev, int root, int *dist, struct spwork *w);
+
+struct oraclestats {
+  long mismatches;       /* (router, destination) pairs that differ */
+  int routers;           /* routers with at least one */
+  int router, dest;      /* the first, by router then destination, or -1 */
+  int got, want;         /* its cost in the table, and the right one */
+  double seconds;
+};
+
+/* compare best[s][d] with the cheapest path from s to d for every s
+   and d, on nthreads threads */
+void oracle_check(const struct topology *t, const int *edgecost,
+                  int *const *best, int nthreads, struct oraclestats *st);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+#define SLABBYTES  (64 * 1024)
+
+/* every slab starts with this header, objects follow it */
+union slabhead {
+  void *next;
+  long double align;
+};
+
+void pool_init(struct pool *p, size_t objsize)
+{
+  /* objects hold the free-list link while free, and stay aligned */
+  if (objsize < sizeof(void *))
+    objsize = sizeof(void *);
+  objsize = (objsize + sizeof(union slabhead) - 1) /
+            sizeof(union slabhead) * sizeof(union slabhead);
+  p->objsize = objsize;
+  p->perslab = (int)(SLABBYTES / objsize);
+  if (p->perslab < 1)
+    p->perslab = 1;
+  p->freelist = NULL;
+  p->slabs = NULL;
+  p->heapallocs = 0;
+  p->allocs = 0;
+  p->inuse = 0;
+  p->peak = 0;
+}
+
+void pool_destroy(struct pool *p)
+{
+  union slabhead *s, *next;
+
+  for (s = p->slabs; s != NULL; s = next) {
+    next = s->next;
+    free(s);
+  }
+  p->slabs = NULL;
+  p->freelist = NULL;
+}
+
+static void pool_grow(struct pool *p)
+{
+  union slabhead *s;
+  char *obj;
+  int i;
+
+  s = malloc(sizeof(union slabhead) + (size_t)p->perslab * p->objsize);
+  if (s == NULL) {
+    printf("Panic: out of memory growing a pool\n");
+    exit(1);
+  }
+  p->heapallocs++;
+  s->next = p->slabs;
+  p->slabs = s;
+  obj = (char *)(s + 1);
+  for (i = 0; i < p->perslab; i++, obj += p->objsize) {
+    *(void **)obj = p->freelist;
+    p->freelist = obj;
+  }
+}
+
+void *pool_get(struct pool *p)
+{
+  void *obj;
+
+  if (p->freelist == NULL)
+    pool_grow(p);
+  obj = p->freelist;
+  p->freelist = *(void **)obj;
+  p->allocs++;
+  if (++p->inuse > p->peak)
+    p->peak = p->inuse;
+  return obj;
+}
+
+void pool_put(struct pool *p, void *obj)
+{
+  *(void **)obj = p->freelist;
+  p->freelist = obj;
+  p->inuse--;
+}
@@ -0,0 +1,28 @@
+/* ******************************************************************
+ Fixed-size object pool.  Objects are carved out of slabs obtained
+ with malloc and recycled through a free list, so once the pool has
+ grown to the peak number of live objects it never calls malloc again.
+ Slabs are only returned to the heap by pool_destroy().
+**********************************************************************/
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+struct pool {
+  size_t objsize;
+  int perslab;
+  void *freelist;               /* next free object, linked through it */
+  void *slabs;                  /* every slab, linked through its head */
+  unsigned long heapallocs;     /* mallocs made, one per slab */
+  unsigned long allocs;         /* objects handed out */
+  long inuse;
+  long peak;
+};
+
+void pool_init(struct pool *p, size_t objsize);
+void pool_destroy(struct pool *p);
+void *pool_get(struct pool *p);
+void pool_put(struct pool *p, void *obj);
+
+#endif
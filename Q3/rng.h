@@ -0,0 +1,43 @@
+/* ******************************************************************
+ Small self-contained random number streams.  Unlike rand(), every
+ stream has its own state, so the numbers one part of the simulation
+ draws do not depend on what any other part has drawn before it.
+**********************************************************************/
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* splitmix64 (S. Vigna): one 64-bit word of state, any seed is fine */
+static inline uint64_t splitmix64(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* xoshiro256** (D. Blackman, S. Vigna): 256 bits of state, which must
+   not be all zero; seed it from splitmix64 */
+static inline uint64_t xoshiro256ss(uint64_t s[4])
+{
+  uint64_t x = s[1] * 5, t = s[1] << 17;
+  uint64_t result = ((x << 7) | (x >> 57)) * 9;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+  return result;
+}
+
+/* uniform float in [0,1) from the top 24 bits of a 64-bit draw */
+static inline float rng_float(uint64_t x)
+{
+  return (float)(x >> 40) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -0,0 +1,809 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "distance_vector.h"
+#include "router.h"
+#include "dvkernels.h"
+#include "topology.h"
+#include "snapshot.h"
+#include "fib.h"
+#include "rng.h"
+
+int rtpolicy = RT_LEGACY;
+float holddown = 0.0;
+float advertise = 0.0;
+float routetimeout = 0.0;
+float coalesce = 0.0;
+
+/* print "Node 1", "Node 1 and 2" or "Node 1, 2, and 3" */
+static void printneighbors(struct router *r)
+{
+  int k;
+
+  printf("Node");
+  for (k = 0; k < r->nneighbors; k++) {
+    if (k > 0 && r->nneighbors > 2)
+      printf(",");
+    if (k > 0 && k == r->nneighbors - 1)
+      printf(" and");
+    printf(" %d", r->neighbors[k]);
+  }
+}
+
+/* "{0,1,2,4}" for a full vector, "{1:3,2:4}" for a delta */
+static void printvector(int *v, int *dest, int n)
+{
+  int i;
+
+  printf("{");
+  for (i = 0; i < n; i++) {
+    if (i)
+      printf(",");
+    if (dest != NULL)
+      printf("%d:", dest[i]);
+    printf("%d", v[i]);
+  }
+  printf("}");
+}
+
+/* the cost to dest we tell neighbor k: with poisoned reverse, the
+   neighbor our route goes through hears that we can not get there */
+static int advertised(struct router *r, int dest, int k)
+{
+  if (k >= 0 && rtpolicy == RT_POISON && r->nexthop[dest] == r->neighbors[k]
+      && dest != r->neighbors[k])
+    return INFINITY;
+  return r->best[dest];
+}
+
+/* build the vector for neighbor k, or for all of them if k < 0, into
+   mincosts; with delta updates only the costs that changed since sent[]
+   go in.  Returns the number of entries. */
+static int buildvector(struct router *r, int k, int *sent)
+{
+  int i, n, cost;
+
+  n = 0;
+  for (i = 0; i < nnodes; i++) {
+    cost = advertised(r, i, k);
+    if (!deltaupdates)
+      r->mincosts[n++] = cost;
+    else if (cost != sent[i]) {
+      sent[i] = cost;
+      r->deltadest[n] = i;
+      r->mincosts[n++] = cost;
+    }
+  }
+  return n;
+}
+
+static void sendto(struct router *r, int k, int n)
+{
+  struct rtpkt updatepacket;
+
+  creatertpkt(&updatepacket, r->id, r->neighbors[k], r->mincosts);
+  if (deltaupdates) {
+    updatepacket.dest = r->deltadest;
+    updatepacket.nentries = n;
+  }
+  tolayer2(updatepacket);
+}
+
+/* send our minimum costs, the diagonal of the table, to every directly
+   connected neighbor.  With delta updates only the costs that changed
+   since the last time are sent, and nothing if none did.  Poisoned
+   reverse tells each neighbor something different. */
+static void sendtoneighbors(struct router *r)
+{
+  int k, n;
+
+  if (rtpolicy == RT_POISON) {
+    for (k = 0; k < r->nneighbors; k++) {
+      n = buildvector(r, k, deltaupdates ? &r->sent[(size_t)k * nnodes] : NULL);
+      if (n == 0)
+        continue;
+      sendto(r, k, n);
+      if (TRACE>0) {
+        printf("Node %d sent the following packet ", r->id);
+        printvector(r->mincosts, deltaupdates ? r->deltadest : NULL, n);
+        printf(" to Node %d.\n", r->neighbors[k]);
+      }
+    }
+    return;
+  }
+  n = buildvector(r, -1, r->sent);
+  if (n == 0)
+    return;
+  for (k = 0; k < r->nneighbors; k++)
+    sendto(r, k, n);
+  if (TRACE>0) {
+    printf("Node %d sent the following packet ", r->id);
+    printvector(r->mincosts, deltaupdates ? r->deltadest : NULL, n);
+    printf(" to ");
+    printneighbors(r);
+    printf(".\n");
+  }
+}
+
+/* the tables of router id, uninitialized */
+static void rtalloc(struct router *r, int id)
+{
+  size_t nvec;
+
+  r->id = id;
+  r->nneighbors = topo_degree(topo, id);
+  r->neighbors = &topo->adj[topo->rowstart[id]];
+  r->linkcosts = malloc((r->nneighbors ? r->nneighbors : 1) * sizeof(int));
+  nvec = r->nneighbors ? r->nneighbors : 1;
+  r->costs = malloc(nvec * nnodes * sizeof(int));
+  r->best = malloc(nnodes * sizeof(int));
+  r->mincosts = malloc(nnodes * sizeof(int));
+  r->nexthop = malloc(nnodes * sizeof(int));
+  r->sent = r->deltadest = r->heard = NULL;
+  r->helddown = NULL;
+  r->expiry = NULL;
+  if (deltaupdates) {
+    r->sent = malloc((rtpolicy == RT_POISON ? nvec : 1) * nnodes * sizeof(int));
+    r->deltadest = malloc(nnodes * sizeof(int));
+  }
+  if (deltaupdates || rtpolicy != RT_LEGACY)
+    r->heard = malloc(nvec * nnodes * sizeof(int));
+  if (holddown > 0.0)
+    r->helddown = calloc(nnodes, 1);
+  if (routetimeout > 0.0)
+    r->expiry = malloc(nnodes * sizeof(struct wtimer));
+  if (r->linkcosts == NULL || r->costs == NULL || r->best == NULL ||
+      r->mincosts == NULL || r->nexthop == NULL ||
+      (deltaupdates && (r->sent == NULL || r->deltadest == NULL)) ||
+      ((deltaupdates || rtpolicy != RT_LEGACY) && r->heard == NULL) ||
+      (holddown > 0.0 && r->helddown == NULL) ||
+      (routetimeout > 0.0 && r->expiry == NULL)) {
+    printf("Panic: out of memory for router %d\n", id);
+    exit(1);
+  }
+}
+
+/* entries of sent[] and heard[] in use */
+static size_t nsent(struct router *r)
+{
+  return (size_t)(rtpolicy == RT_POISON ? r->nneighbors : 1) * nnodes;
+}
+
+static size_t nheard(struct router *r)
+{
+  return (size_t)r->nneighbors * nnodes;
+}
+
+/* entries of the table */
+static size_t ncosts(struct router *r)
+{
+  return (size_t)r->nneighbors * nnodes;
+}
+
+/************************** COROUTINES ***************************/
+/* A router's coroutines await time with RT_SLEEP(), on a timer of the
+   wheel, and a change of their router's vector with CO_SIGNAL.  The
+   resume points are numbered per coroutine, up to RT_MAXPOINT. */
+
+#define RT_SLEEP(r, k, point, delay)                              \
+  do {                                                            \
+    armtimer(&(r)->cotimer[k], (r)->id, (delay), RT_WAKE(k));     \
+    CO_AWAIT(&(r)->co[k], point, CO_TIME);                        \
+  } while (0)
+
+#define RT_MAXPOINT     2
+
+/* send the whole vector, as if every entry had changed */
+static void sendall(struct router *r)
+{
+  size_t i;
+
+  if (r->sent != NULL)
+    for (i = 0; i < nsent(r); i++)
+      r->sent[i] = -1;             /* no cost is, so every entry goes */
+  sendtoneighbors(r);
+}
+
+/* RIP's periodic update: every advertise time units, give or take a
+   quarter so that the routers do not fall into step, each tells its
+   neighbors everything, whether or not anything changed */
+static void advertiser(struct router *r)
+{
+  struct coroutine *co = &r->co[RT_ADVERTISER];
+
+  CO_BEGIN(co);
+  while (1) {
+    RT_SLEEP(r, RT_ADVERTISER, 1,
+             advertise * (0.75f + 0.5f * rng_float(splitmix64(&r->rng))));
+    if (TRACE>0)
+      printf("\nrttimer%d: periodic update\n", r->id);
+    sendall(r);
+  }
+  CO_END(co);
+}
+
+/* a change opens a window of coalesce time units; the ones that come
+   before it closes go out with it, in the one update sent then */
+static void coalescer(struct router *r)
+{
+  struct coroutine *co = &r->co[RT_COALESCER];
+
+  CO_BEGIN(co);
+  while (1) {
+    CO_AWAIT(co, 1, CO_SIGNAL);
+    RT_SLEEP(r, RT_COALESCER, 2, coalesce);
+    r->nwindows++;
+    r->heldfor += r->inwindow * (double)rtclock() - r->heldsince;
+    r->inwindow = 0;
+    r->heldsince = 0.0;
+    if (TRACE>0)
+      printf("\nrttimer%d: coalescing window closed\n", r->id);
+    sendtoneighbors(r);
+    if (TRACE>0)
+      printdt(r);
+  }
+  CO_END(co);
+}
+
+static void (*const coroutines[RT_NCO])(struct router *) = {
+  [RT_ADVERTISER] = advertiser,
+  [RT_COALESCER] = coalescer,
+};
+
+/* go on with coroutine k if it is waiting for what just happened */
+static void resume(struct router *r, int k, int what)
+{
+  if (k >= 0 && k < RT_NCO && r->co[k].waiting == what)
+    coroutines[k](r);
+}
+
+/* set the coroutines going that the settings ask for; each runs up to
+   its first await */
+static void startcoroutines(struct router *r)
+{
+  int k;
+
+  r->rng = 0x9e3779b97f4a7c15ULL * (uint64_t)(r->id + 1);
+  for (k = 0; k < RT_NCO; k++) {
+    CO_INIT(&r->co[k]);
+    wtimer_init(&r->cotimer[k]);
+  }
+  if (advertise <= 0.0)
+    r->co[RT_ADVERTISER].waiting = CO_DONE;
+  if (coalesce <= 0.0)
+    r->co[RT_COALESCER].waiting = CO_DONE;
+  for (k = 0; k < RT_NCO; k++)
+    resume(r, k, CO_RUNNING);
+}
+
+/* our vector changed: tell the neighbors now, or with coalescing when
+   the window this change opens or falls in closes.  Every change but
+   the one opening a window would have been an update of its own. */
+static void announce(struct router *r)
+{
+  if (coalesce <= 0.0) {
+    sendtoneighbors(r);
+    return;
+  }
+  r->nheld++;
+  r->inwindow++;
+  r->heldsince += rtclock();
+  if (r->co[RT_COALESCER].waiting == CO_SIGNAL)
+    resume(r, RT_COALESCER, CO_SIGNAL);
+  else
+    r->nsaved += r->nneighbors;
+}
+
+void rtinit(struct router *r, int id)
+{
+  int i, k;
+
+  rtalloc(r, id);
+  if (TRACE>0)
+    printf("rtinit%d: \n", id);
+
+  /* nothing is reachable until we hear about it, except ourselves and
+     our neighbors, whose cost is that of the direct link */
+  for (i = 0; i < (int)ncosts(r); i++)
+    r->costs[i] = INFINITY;
+  for (i = 0; i < nnodes; i++) {
+    r->best[i] = INFINITY;
+    r->nexthop[i] = -1;
+  }
+  if (r->sent != NULL)
+    for (i = 0; i < (int)nsent(r); i++)
+      r->sent[i] = INFINITY;
+  if (r->heard != NULL)
+    for (i = 0; i < (int)nheard(r); i++)
+      r->heard[i] = INFINITY;
+  if (r->expiry != NULL)
+    for (i = 0; i < nnodes; i++)
+      wtimer_init(&r->expiry[i]);
+  r->best[id] = 0;
+  r->nexthop[id] = id;
+  r->nchanged = 0;
+  r->nexpired = 0;
+  r->nheld = r->nwindows = r->nsaved = 0;
+  r->heldfor = r->heldsince = 0.0;
+  r->inwindow = 0;
+  for (k = 0; k < r->nneighbors; k++) {
+    r->linkcosts[k] = topo->cost[topo->rowstart[id] + k];
+    r->best[r->neighbors[k]] = r->linkcosts[k];
+    r->nexthop[r->neighbors[k]] = r->neighbors[k];
+  }
+
+  sendtoneighbors(r);
+  if (TRACE>0)
+    printdt(r);
+  startcoroutines(r);
+}
+
+/* a timer is its expiry and argument, and whether it is armed */
+static void savetimer(struct wtimer *t, struct snapbuf *b)
+{
+  char armed = t->state == WT_ARMED;
+
+  snap_put(b, &armed, 1);
+  if (armed) {
+    snap_put(b, &t->expires, sizeof(t->expires));
+    snap_put(b, &t->arg, sizeof(t->arg));
+  }
+}
+
+static void restoretimer(struct router *r, struct wtimer *t,
+                         struct snapbuf *b)
+{
+  char armed;
+
+  wtimer_init(t);
+  snap_get(b, &armed, 1);
+  if (armed) {
+    snap_get(b, &t->expires, sizeof(t->expires));
+    snap_get(b, &t->arg, sizeof(t->arg));
+    t->node = r->id;
+    rearmtimer(t);
+  }
+}
+
+/* everything but the scratch vectors, in the same order for both */
+void rtsave(struct router *r, struct snapbuf *b)
+{
+  int i, k;
+
+  snap_put(b, r->linkcosts, r->nneighbors * sizeof(int));
+  snap_put(b, r->costs, ncosts(r) * sizeof(int));
+  snap_put(b, r->best, nnodes * sizeof(int));
+  snap_put(b, r->nexthop, nnodes * sizeof(int));
+  if (r->sent != NULL)
+    snap_put(b, r->sent, nsent(r) * sizeof(int));
+  if (r->heard != NULL)
+    snap_put(b, r->heard, nheard(r) * sizeof(int));
+  if (r->helddown != NULL)
+    snap_put(b, r->helddown, nnodes);
+  snap_put(b, &r->nchanged, sizeof(r->nchanged));
+  snap_put(b, &r->nexpired, sizeof(r->nexpired));
+  snap_put(b, &r->nheld, sizeof(r->nheld));
+  snap_put(b, &r->nwindows, sizeof(r->nwindows));
+  snap_put(b, &r->nsaved, sizeof(r->nsaved));
+  snap_put(b, &r->heldfor, sizeof(r->heldfor));
+  snap_put(b, &r->heldsince, sizeof(r->heldsince));
+  snap_put(b, &r->inwindow, sizeof(r->inwindow));
+  snap_put(b, r->co, sizeof(r->co));
+  snap_put(b, &r->rng, sizeof(r->rng));
+  for (k = 0; k < RT_NCO; k++)
+    savetimer(&r->cotimer[k], b);
+  if (r->expiry != NULL)
+    for (i = 0; i < nnodes; i++)
+      savetimer(&r->expiry[i], b);
+}
+
+void rtrestore(struct router *r, int id, struct snapbuf *b)
+{
+  int i, k;
+
+  rtalloc(r, id);
+  snap_get(b, r->linkcosts, r->nneighbors * sizeof(int));
+  snap_get(b, r->costs, ncosts(r) * sizeof(int));
+  snap_get(b, r->best, nnodes * sizeof(int));
+  snap_get(b, r->nexthop, nnodes * sizeof(int));
+  if (r->sent != NULL)
+    snap_get(b, r->sent, nsent(r) * sizeof(int));
+  if (r->heard != NULL)
+    snap_get(b, r->heard, nheard(r) * sizeof(int));
+  if (r->helddown != NULL)
+    snap_get(b, r->helddown, nnodes);
+  snap_get(b, &r->nchanged, sizeof(r->nchanged));
+  snap_get(b, &r->nexpired, sizeof(r->nexpired));
+  snap_get(b, &r->nheld, sizeof(r->nheld));
+  snap_get(b, &r->nwindows, sizeof(r->nwindows));
+  snap_get(b, &r->nsaved, sizeof(r->nsaved));
+  snap_get(b, &r->heldfor, sizeof(r->heldfor));
+  snap_get(b, &r->heldsince, sizeof(r->heldsince));
+  snap_get(b, &r->inwindow, sizeof(r->inwindow));
+  snap_get(b, r->co, sizeof(r->co));
+  snap_get(b, &r->rng, sizeof(r->rng));
+  /* a point no coroutine has would silently stop it: count it as
+     damage, like a snapshot cut short */
+  for (k = 0; k < RT_NCO; k++)
+    if (r->co[k].resume < -1 || r->co[k].resume > RT_MAXPOINT ||
+        r->co[k].waiting < CO_RUNNING || r->co[k].waiting > CO_DONE)
+      b->overrun = 1;
+  for (k = 0; k < RT_NCO; k++)
+    restoretimer(r, &r->cotimer[k], b);
+  if (r->expiry != NULL)
+    for (i = 0; i < nnodes; i++)
+      restoretimer(r, &r->expiry[i], b);
+}
+
+void rtfree(struct router *r)
+{
+  free(r->linkcosts);
+  free(r->costs);
+  free(r->best);
+  free(r->mincosts);
+  free(r->nexthop);
+  free(r->sent);
+  free(r->deltadest);
+  free(r->heard);
+  free(r->helddown);
+  free(r->expiry);
+}
+
+/* position of node id in our neighbor list, -1 if it is not there */
+static int neighborindex(struct router *r, int id)
+{
+  int lo = 0, hi = r->nneighbors - 1, mid;
+
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    if (r->neighbors[mid] == id)
+      return mid;
+    if (r->neighbors[mid] < id)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+/* cost of the route to dest through our k'th neighbor.  The direct
+   route to a neighbor is the link itself, not its entry in the table. */
+static int via(struct router *r, int dest, int k)
+{
+  if (dest == r->neighbors[k])
+    return r->linkcosts[k];
+  return DT(r, dest, k);
+}
+
+/* with route timeouts, the route to dest is good for routetimeout from
+   when it was set up or its next hop last mentioned it */
+static void keeproute(struct router *r, int dest)
+{
+  if (r->expiry != NULL && r->nexthop[dest] >= 0 &&
+      r->nexthop[dest] != dest && r->best[dest] < INFINITY)
+    armtimer(&r->expiry[dest], r->id, routetimeout, RT_EXPIRE(dest));
+}
+
+/* the best route to dest got worse: find it again among the columns of
+   our neighbors, the only ones that ever hold a route.  Returns 1 if the
+   route changed, in cost or in next hop. */
+static int rescan(struct router *r, int dest)
+{
+  int k, best, hop, changed;
+
+  best = INFINITY;
+  hop = -1;
+  for (k = 0; k < r->nneighbors; k++)
+    if (via(r, dest, k) < best) {
+      best = via(r, dest, k);
+      hop = r->neighbors[k];
+    }
+  changed = best != r->best[dest] || hop != r->nexthop[dest];
+  r->best[dest] = best;
+  r->nexthop[dest] = hop;
+  if (changed)
+    keeproute(r, dest);
+  return changed;
+}
+
+/* Bellman-Ford and poisoned reverse: the route to dest through our k'th
+   neighbor now costs cost, replacing what it cost before, better or
+   worse.  Returns 1 if our best route to dest changed.  During a
+   hold-down, dest keeps its next hop whatever the others offer. */
+static int setroute(struct router *r, int dest, int k, int cost)
+{
+  int nb = r->neighbors[k];
+
+  if (dest != nb)
+    DT(r, dest, k) = cost;
+  if (r->nexthop[dest] == nb) {
+    if (cost <= r->best[dest]) {
+      if (cost == r->best[dest])
+        return 0;
+      r->best[dest] = cost;
+      return 1;
+    }
+    if (holddown <= 0.0)
+      return rescan(r, dest);
+    r->best[dest] = cost;           /* worse, but where we are going */
+    if (!r->helddown[dest]) {
+      r->helddown[dest] = 1;
+      starttimer(r->id, holddown, RT_HOLDDOWN(dest));
+    }
+    return 1;
+  }
+  if (cost < r->best[dest] && (r->helddown == NULL || !r->helddown[dest])) {
+    r->best[dest] = cost;
+    r->nexthop[dest] = nb;
+    keeproute(r, dest);
+    return 1;
+  }
+  return 0;
+}
+
+/* recompute the routes through our k'th neighbor from what it last told
+   us and what the link to it costs now; returns 1 if any best route
+   changed */
+static int setcolumn(struct router *r, int k)
+{
+  int *heard = &r->heard[(size_t)k * nnodes];
+  int i, cost, changed;
+
+  changed = 0;
+  for (i = 0; i < nnodes; i++) {
+    if (i == r->id)
+      continue;
+    cost = i == r->neighbors[k] ? r->linkcosts[k] : r->linkcosts[k] + heard[i];
+    if (cost > INFINITY)
+      cost = INFINITY;
+    if ((cost != via(r, i, k) || i == r->neighbors[k]) &&
+        setroute(r, i, k, cost)) {
+      r->nchanged++;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+static void update(struct router *r, struct rtpkt *rcvdpkt)
+{
+  int neighborid = rcvdpkt->sourceid;
+  int *neighborcosts = rcvdpkt->mincost;
+  int *col, i, k, updated;
+
+  if (TRACE>0) {
+    printf("rtupdate%d: \n", r->id);
+    printf("Received packet: ");
+    printvector(neighborcosts, rcvdpkt->dest, rcvdpkt->nentries);
+    printf(" \n");
+  }
+
+  /* a delta only carries what changed: merge it into the last vector
+     heard from the neighbor, which is then relaxed as a whole, since our
+     own cost to the neighbor may have dropped since it was heard.  The
+     replacing policies keep every vector, for when a link cost changes. */
+  k = neighborindex(r, neighborid);
+  if (k < 0)
+    return;
+  if (r->heard != NULL) {
+    neighborcosts = &r->heard[(size_t)k * nnodes];
+    for (i = 0; i < rcvdpkt->nentries; i++)
+      neighborcosts[rcvdpkt->dest != NULL ? rcvdpkt->dest[i] : i] =
+        rcvdpkt->mincost[i];
+  }
+
+  if (rtpolicy != RT_LEGACY) {
+    if (setcolumn(r, k)) {
+      if (TRACE>0) {
+        printf("There is a LINK COST CHANGE: Node %d will send updates to ",
+               r->id);
+        printneighbors(r);
+        printf(". \n\n");
+      }
+      announce(r);
+      if (TRACE>0)
+        printdt(r);
+    }
+    if (TRACE>0)
+      printf("\n\n");
+    return;
+  }
+
+  /* Bellman-Ford: D_x(y) = min_v { c(x,v) + D_v(y) }, where our cost to
+     the neighbor v is best[v] and D_v(y) is what v just told us.  All of
+     it lands in v's column of the table, whose entry for v itself stands
+     for best[v] so that it never counts as an update. */
+  col = &DT(r, 0, k);
+  col[neighborid] = r->best[neighborid];
+  updated = dvk_relax(col, neighborcosts, r->best[neighborid], nnodes);
+
+  if (updated) {
+    if (TRACE>0) {
+      printf("There is a LINK COST CHANGE: Node %d will send updates to ",
+             r->id);
+      printneighbors(r);
+      printf(". \n\n");
+    }
+    /* only the sender's column went down, so a route can only get
+       better, and only through the sender */
+    for (i = 0; i < nnodes; i++)
+      if (col[i] < r->best[i]) {
+        r->best[i] = col[i];
+        r->nchanged++;
+        r->nexthop[i] = neighborid;
+      }
+    announce(r);
+    if (TRACE>0)
+      printdt(r);
+  }
+  if (TRACE>0)
+    printf("\n\n");
+}
+
+void rtupdate(struct router *r, struct rtpkt *rcvdpkt)
+{
+  int i, dest;
+
+  update(r, rcvdpkt);
+  if (r->expiry != NULL)
+    for (i = 0; i < rcvdpkt->nentries; i++) {
+      dest = rcvdpkt->dest != NULL ? rcvdpkt->dest[i] : i;
+      if (r->nexthop[dest] == rcvdpkt->sourceid)
+        keeproute(r, dest);
+    }
+}
+
+/* called when the cost of our link to linkid changes to newcost */
+void linkhandler(struct router *r, int linkid, int newcost)
+{
+  int k, oldcost, changed;
+
+  if (TRACE>0)
+    printf("\nlinkhandler%d: Link cost between node %d and %d changed from %d to %d\n",
+           r->id, r->id, linkid, r->best[linkid], newcost);
+  k = neighborindex(r, linkid);
+  if (k < 0)
+    return;
+  r->linkcosts[k] = newcost;
+
+  if (rtpolicy != RT_LEGACY)
+    /* every route through linkid changes by the same amount */
+    changed = setcolumn(r, k);
+  else {
+    /* the new cost replaces our best route to linkid, whatever it went
+       through; if that is worse, some other neighbor may now do better */
+    oldcost = r->best[linkid];
+    r->best[linkid] = newcost;
+    r->nexthop[linkid] = linkid;
+    if (newcost > oldcost)
+      rescan(r, linkid);
+    changed = r->best[linkid] < newcost;
+    if (r->best[linkid] != oldcost)
+      r->nchanged++;
+  }
+  if (changed) {
+    if (TRACE>0) {
+      printf("There is a LINK COST CHANGE: Node %d will send updates to ",
+             r->id);
+      printneighbors(r);
+      printf(".\n");
+    }
+    announce(r);
+  }
+  if (TRACE>0) {
+    printf("Distance table after link cost change:\n");
+    printdt(r);
+  }
+}
+
+/* our FIB: for every destination, the neighbor our best route goes
+   via and the cost of the link to it */
+void rtfib(struct router *r, struct fibentry *fib)
+{
+  int *index = r->mincosts;       /* scratch until the next send */
+  int i, k;
+
+  for (k = 0; k < r->nneighbors; k++)
+    index[r->neighbors[k]] = k;
+  for (i = 0; i < nnodes; i++) {
+    fib[i].nexthop = -1;
+    fib[i].cost = INFINITY;
+    if (i == r->id) {
+      fib[i].nexthop = r->id;
+      fib[i].cost = 0;
+      continue;
+    }
+    if (r->nexthop[i] < 0 || r->best[i] >= INFINITY)
+      continue;
+    k = index[r->nexthop[i]];
+    fib[i].nexthop = r->nexthop[i];
+    fib[i].cost = r->linkcosts[k];
+  }
+}
+
+/* nothing was heard of the route to dest for routetimeout: its next hop
+   may as well have told us that it can not get there any more */
+static void expire(struct router *r, int dest)
+{
+  int k;
+
+  if (dest < 0 || dest >= nnodes || r->heard == NULL ||
+      r->best[dest] >= INFINITY || r->nexthop[dest] == dest ||
+      (k = neighborindex(r, r->nexthop[dest])) < 0)
+    return;
+  r->nexpired++;
+  if (TRACE>0)
+    printf("\nrttimer%d: the route to node %d via %d timed out\n", r->id,
+           dest, r->nexthop[dest]);
+  r->heard[(size_t)k * nnodes + dest] = INFINITY;
+  if (setroute(r, dest, k, INFINITY)) {
+    r->nchanged++;
+    if (TRACE>0) {
+      printf("There is a LINK COST CHANGE: Node %d will send updates to ",
+             r->id);
+      printneighbors(r);
+      printf(".\n");
+    }
+    announce(r);
+    if (TRACE>0)
+      printdt(r);
+  }
+}
+
+/* a hold-down on dest ran out: take the best route on offer again */
+void rttimer(struct router *r, int arg)
+{
+  int dest = arg;
+
+  if (arg < RT_WAKE(RT_NCO - 1)) {
+    expire(r, RT_EXPIRE(0) - arg);
+    return;
+  }
+  if (arg < 0) {
+    resume(r, RT_WAKE(0) - arg, CO_TIME);
+    return;
+  }
+  if (r->helddown == NULL || dest < 0 || dest >= nnodes)
+    return;
+  r->helddown[dest] = 0;
+  if (TRACE>0)
+    printf("\nrttimer%d: hold-down on node %d is over\n", r->id, dest);
+  if (rescan(r, dest)) {
+    r->nchanged++;
+    if (TRACE>0) {
+      printf("There is a LINK COST CHANGE: Node %d will send updates to ",
+             r->id);
+      printneighbors(r);
+      printf(".\n");
+    }
+    announce(r);
+    if (TRACE>0)
+      printdt(r);
+  }
+}
+
+/* one row per destination other than ourselves, one column per neighbor */
+void printdt(struct router *r)
+{
+  int i, k, row;
+
+  printf("      %*svia\n", 3 * r->nneighbors, "");
+  printf("   D%-2d|", r->id);
+  for (k = 0; k < r->nneighbors; k++)
+    printf(k ? "%6d" : "%5d", r->neighbors[k]);
+  printf("\n  ----|");
+  for (k = 0; k < r->nneighbors; k++)
+    printf(k ? "------" : "-----");
+  printf("\n");
+  row = 0;
+  for (i = 0; i < nnodes; i++) {
+    if (i == r->id)
+      continue;
+    printf(row == (nnodes - 2) / 2 ? "dest%2d|" : "    %2d|", i);
+    for (k = 0; k < r->nneighbors; k++)
+      printf(k ? "%6d" : "%5d",
+             i == r->neighbors[k] ? r->best[i] : DT(r, i, k));
+    printf("\n");
+    row++;
+  }
+}
@@ -0,0 +1,101 @@
+/* ******************************************************************
+ The distance vector routing process.  One struct router is
+ instantiated per node by the emulator; all nodes share this code and
+ differ only in their id and their links, which come from the topology.
+**********************************************************************/
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdint.h>
+
+#include "coroutine.h"
+#include "twheel.h"
+
+#define INFINITY 999
+
+/* how a router takes in what its neighbors tell it */
+enum {
+  RT_LEGACY,           /* the assignment's: a cost only ever goes down */
+  RT_BELLMANFORD,      /* the newest vector from a neighbor replaces the
+                          last one, so costs can go up again */
+  RT_POISON,           /* as RT_BELLMANFORD, with split horizon and
+                          poisoned reverse */
+};
+extern int rtpolicy;
+extern float holddown;     /* > 0: hold a worsened route this long */
+extern float advertise;    /* > 0: send the whole vector about this often */
+extern float routetimeout; /* > 0: drop a route not heard of for this long */
+extern float coalesce;     /* > 0: send what changed at most once this long
+                              after the first change */
+
+/* the coroutines every router runs, see coroutine.h */
+enum {
+  RT_ADVERTISER,       /* advertise > 0: the periodic updates */
+  RT_COALESCER,        /* coalesce > 0: the updates held for it */
+  RT_NCO
+};
+
+struct rtpkt;
+struct snapbuf;
+struct fibentry;
+
+struct router {
+  int id;
+  int nneighbors;
+  int *neighbors;      /* ids of the directly connected nodes, ascending */
+  int *linkcosts;      /* current cost of the link to each of them */
+  int *costs;          /* distance table, see DT() */
+  int *best;           /* our minimum cost to each node, the vector we
+                          advertise */
+  int *mincosts;       /* the vector we advertise, built before sending */
+  int *nexthop;        /* neighbor the best route to each node goes via,
+                          -1 if there is none */
+  /* delta updates only */
+  int *sent;           /* the costs we last advertised, per neighbor
+                          with poisoned reverse */
+  int *deltadest;      /* node of each entry of a delta being sent */
+  /* delta updates and the replacing policies */
+  int *heard;          /* nneighbors x nnodes, the vectors last heard */
+  char *helddown;      /* holddown > 0: per node, in a hold-down */
+  unsigned long nchanged;  /* times a best route changed */
+  struct coroutine co[RT_NCO];
+  struct wtimer cotimer[RT_NCO];  /* what a coroutine sleeps on */
+  struct wtimer *expiry;  /* routetimeout > 0: per node, when the route
+                             to it times out */
+  unsigned long nexpired;  /* routes that timed out */
+  uint64_t rng;        /* for the coroutines' random delays */
+  /* coalesce > 0 */
+  unsigned long nheld;     /* vector changes, each would have been sent */
+  unsigned long nwindows;  /* ... and the updates they went out in */
+  unsigned long nsaved;    /* about the packets the others would have
+                              taken */
+  double heldfor;          /* time the changes waited, in all */
+  double heldsince;        /* sum of when those of the open window came */
+  int inwindow;            /* how many did */
+};
+
+/* cost to node dest via our k'th neighbor.  Only neighbors can be a
+   next hop, so the table has a column per neighbor rather than per
+   node, nnodes x nneighbors in all, stored one column after another so
+   that a vector received from a neighbor updates one contiguous column.
+   best[i] is kept up to date as columns change, with the neighbor it
+   goes via in nexthop[i]. */
+#define DT(r, dest, k)  ((r)->costs[(size_t)(k) * nnodes + (dest)])
+
+void rtinit(struct router *r, int id);
+void rtfree(struct router *r);
+/* write a router's state to a snapshot, or set up router id from one */
+void rtsave(struct router *r, struct snapbuf *b);
+void rtrestore(struct router *r, int id, struct snapbuf *b);
+void rtupdate(struct router *r, struct rtpkt *rcvdpkt);
+void linkhandler(struct router *r, int linkid, int newcost);
+/* a timer the router started ran out; what for is in arg */
+#define RT_HOLDDOWN(dest)  (dest)
+#define RT_WAKE(k)         (-1 - (k))
+#define RT_EXPIRE(dest)    (-1 - RT_NCO - (dest))
+void rttimer(struct router *r, int arg);
+void printdt(struct router *r);
+/* compile the router's forwarding table, nnodes entries, see fib.h */
+void rtfib(struct router *r, struct fibentry *fib);
+
+#endif
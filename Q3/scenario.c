@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scenario.h"
+#include "topology.h"
+
+#define MAXSCNCOST 999       /* a link can go down, unlike in a topology */
+
+/* a change and where it was in the file, for a stable sort */
+struct numbered {
+  struct linkchange c;
+  int pos;
+};
+
+static int cmpnumbered(const void *a, const void *b)
+{
+  const struct numbered *x = a, *y = b;
+
+  if (x->c.time != y->c.time)
+    return x->c.time < y->c.time ? -1 : 1;
+  return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+struct scenario *scenario_fromchanges(int nchanges,
+                                      const struct linkchange *changes)
+{
+  struct scenario *s;
+  struct numbered *tmp;
+  int i;
+
+  s = calloc(1, sizeof(struct scenario));
+  tmp = malloc((nchanges ? nchanges : 1) * sizeof(struct numbered));
+  if (s == NULL || tmp == NULL) {
+    free(s);
+    free(tmp);
+    return NULL;
+  }
+  for (i = 0; i < nchanges; i++) {
+    tmp[i].c = changes[i];
+    tmp[i].pos = i;
+  }
+  qsort(tmp, nchanges, sizeof(struct numbered), cmpnumbered);
+  s->nchanges = nchanges;
+  s->changes = malloc((nchanges ? nchanges : 1) * sizeof(struct linkchange));
+  if (s->changes == NULL) {
+    free(s);
+    free(tmp);
+    return NULL;
+  }
+  for (i = 0; i < nchanges; i++)
+    s->changes[i] = tmp[i].c;
+  free(tmp);
+  return s;
+}
+
+struct scenario *scenario_load(const char *path, const struct topology *t)
+{
+  struct scenario *s;
+  struct linkchange *changes, *grown;
+  FILE *fp;
+  char line[256], *p;
+  int nchanges, cap, lineno, a, b, c;
+  float time;
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+    printf("scenario: can not open %s\n", path);
+    return NULL;
+  }
+  changes = NULL;
+  nchanges = cap = 0;
+  lineno = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    lineno++;
+    if ((p = strchr(line, '#')) != NULL)
+      *p = '\0';
+    for (p = line; *p == ' ' || *p == '\t'; p++)
+      ;
+    if (*p == '\0' || *p == '\n' || *p == '\r')
+      continue;
+    if (sscanf(p, "%f %d %d %d", &time, &a, &b, &c) != 4 || time < 0.0 ||
+        c < 0 || c > MAXSCNCOST) {
+      printf("scenario: %s:%d: expected \"time node node cost\" with "
+             "time >= 0 and 0 <= cost <= %d\n", path, lineno, MAXSCNCOST);
+      goto fail;
+    }
+    if (a < 0 || a >= t->nnodes || b < 0 || b >= t->nnodes ||
+        topo_edge(t, a, b) < 0) {
+      printf("scenario: %s:%d: there is no link %d-%d\n", path, lineno, a, b);
+      goto fail;
+    }
+    if (nchanges == cap) {
+      cap = cap ? 2 * cap : 256;
+      grown = realloc(changes, cap * sizeof(*changes));
+      if (grown == NULL) {
+        printf("scenario: out of memory reading %s\n", path);
+        goto fail;
+      }
+      changes = grown;
+    }
+    changes[nchanges].time = time;
+    changes[nchanges].a = a;
+    changes[nchanges].b = b;
+    changes[nchanges].cost = c;
+    nchanges++;
+  }
+  fclose(fp);
+  s = scenario_fromchanges(nchanges, changes);
+  if (s == NULL)
+    printf("scenario: out of memory reading %s\n", path);
+  free(changes);
+  return s;
+
+fail:
+  fclose(fp);
+  free(changes);
+  return NULL;
+}
+
+void scenario_free(struct scenario *s)
+{
+  if (s == NULL)
+    return;
+  free(s->changes);
+  free(s);
+}
@@ -0,0 +1,38 @@
+/* ******************************************************************
+ Scenarios: scripted changes of link costs over the course of a run.
+ A scenario file holds one change per line,
+
+     # comment
+     10000 0 1 20     at t=10000 the link 0-1 starts costing 20
+     20000 0 1 1
+     30000 0 1 999    at t=30000 it goes down ...
+     30000 0 1 4      ... and comes straight back up costing 4
+
+ in any order; changes to take effect at the same time are applied in
+ file order, each at node a, the first of the line, before node b.  A
+ cost of 999 takes the link down.  Every change must be to a link of
+ the topology the scenario is run on.
+**********************************************************************/
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+struct topology;
+
+struct linkchange {
+  float time;
+  int a, b;            /* ends of the link */
+  int cost;            /* its new cost */
+};
+
+struct scenario {
+  int nchanges;
+  struct linkchange *changes;    /* sorted by time */
+};
+
+/* NULL on error, after saying why */
+struct scenario *scenario_load(const char *path, const struct topology *t);
+struct scenario *scenario_fromchanges(int nchanges,
+                                      const struct linkchange *changes);
+void scenario_free(struct scenario *s);
+
+#endif
@@ -0,0 +1,47 @@
+/* ******************************************************************
+ The emulator as a library, for programs that drive simulations
+ themselves instead of through main() (dvbench).  distance_vector.c
+ compiled with -DDV_NOMAIN leaves its main() out.
+
+ The settings are the globals main() fills in from the command line;
+ set them, and topo, nnodes and scenario, before sim_create().
+**********************************************************************/
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct sim;
+struct event;
+struct router;
+struct scenario;
+
+extern const char *evqspec;
+extern int nlps;
+extern float lookahead;
+extern struct scenario *scenario;
+
+struct sim *sim_create(uint64_t simseed);
+void sim_run(struct sim *sim);
+void sim_rununtil(struct sim *sim, float until);
+/* checkpoints, see snapshot.h */
+int sim_save(struct sim *sim, const char *path, float clock);
+struct sim *sim_restore(void *map, size_t size, uint64_t simseed);
+void sim_destroy(struct sim *sim);
+unsigned long sim_events(struct sim *sim);   /* events created so far */
+unsigned long sim_pending(struct sim *sim);  /* ... of them still queued */
+float sim_time(struct sim *sim);             /* how far it has run */
+
+/* act as node: newevent(), insertevent() and tolayer2() then work on
+   node's lp, as they would inside one of its event handlers */
+void sim_enter(struct sim *sim, int node);
+struct router *sim_router(struct sim *sim, int node);
+/* take the earliest event off the entered lp's list, NULL if none */
+struct event *sim_popevent(struct sim *sim);
+
+struct event *newevent();
+void freeevent(struct event *evptr);
+void insertevent(struct event *p);
+
+#endif
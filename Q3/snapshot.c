@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+#include "topology.h"
+
+uint64_t snap_topohash(const struct topology *t)
+{
+  uint64_t h = 14695981039346656037ULL;
+  const unsigned char *p;
+  int i;
+
+  for (i = 0; i <= t->nnodes; i++)
+    h = (h ^ (uint32_t)t->rowstart[i]) * 1099511628211ULL;
+  for (i = 0; i < t->nedges; i++) {
+    h = (h ^ (uint32_t)t->adj[i]) * 1099511628211ULL;
+    h = (h ^ (uint32_t)t->cost[i]) * 1099511628211ULL;
+  }
+  /* and how they carry packets, if not as by default */
+  if (t->link != NULL)
+    for (p = (const unsigned char *)t->link;
+         p < (const unsigned char *)(t->link + t->nedges); p++)
+      h = (h ^ *p) * 1099511628211ULL;
+  return h;
+}
+
+void *snap_create(const char *path, size_t size)
+{
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)size) < 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return NULL;
+  }
+  return map;
+}
+
+void *snap_open(const char *path, size_t *size)
+{
+  const struct snaphdr *h;
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  if (fstat(fd, &st) < 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  if ((size_t)st.st_size < sizeof(struct snaphdr)) {
+    printf("%s: not a snapshot\n", path);
+    close(fd);
+    return NULL;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return NULL;
+  }
+  h = map;
+  if (h->magic != SNAP_MAGIC || h->version != SNAP_VERSION) {
+    printf("%s: not a snapshot, or from another version\n", path);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  *size = st.st_size;
+  return map;
+}
+
+int snap_close(void *map, size_t size)
+{
+  int ok = msync(map, size, MS_SYNC) == 0;
+
+  return munmap(map, size) == 0 && ok;
+}
@@ -0,0 +1,80 @@
+/* ******************************************************************
+ Checkpoints of a whole simulation.  A snapshot file is a struct
+ snaphdr followed by the state of the run: random streams, channels,
+ counters, every router's tables and the pending events.  It is written
+ and read through a shared memory mapping, so taking or restoring a
+ checkpoint of a large network is a copy between memory and the page
+ cache; a restored run then goes on from the snapshot's clock without
+ replaying the initial convergence.
+
+ The layout is the emulator's business (sim_save() and sim_restore());
+ this module maps the file, checks the header and moves bytes.
+**********************************************************************/
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SNAP_MAGIC      0x53565644u      /* "DVVS" */
+#define SNAP_VERSION    7
+
+struct topology;
+
+struct snaphdr {
+  uint32_t magic;
+  uint32_t version;
+  int32_t nnodes;
+  int32_t nedges;
+  uint64_t topohash;     /* of the links, their initial costs and models */
+  int32_t policy;        /* rtpolicy */
+  int32_t delta;         /* deltaupdates */
+  float holddown;
+  float advertise;
+  float timeout;
+  float coalesce;
+  float clock;           /* the time the snapshot was taken at */
+  uint64_t seed;         /* of the run it was taken from */
+  uint64_t nevents;      /* pending events, after the rest of the state */
+};
+
+/* a cursor over a snapshot being written or read.  With base NULL
+   snap_put() only counts, to size the file before mapping it. */
+struct snapbuf {
+  char *base;
+  size_t off;
+  size_t size;
+  int overrun;           /* a snap_get() went past the end, or got
+                            something that makes no sense */
+};
+
+static inline void snap_put(struct snapbuf *b, const void *src, size_t n)
+{
+  if (b->base != NULL)
+    memcpy(b->base + b->off, src, n);
+  b->off += n;
+}
+
+static inline void snap_get(struct snapbuf *b, void *dst, size_t n)
+{
+  if (b->off + n > b->size) {
+    b->overrun = 1;
+    memset(dst, 0, n);
+    return;
+  }
+  memcpy(dst, b->base + b->off, n);
+  b->off += n;
+}
+
+uint64_t snap_topohash(const struct topology *t);
+
+/* a writable mapping of a new size-byte file, NULL on error */
+void *snap_create(const char *path, size_t size);
+/* a read-only mapping of a snapshot whose header checks out, NULL on
+   error; *size is set to the file size */
+void *snap_open(const char *path, size_t *size);
+/* flush (for a mapping from snap_create) and unmap; 0 on error */
+int snap_close(void *map, size_t size);
+
+#endif
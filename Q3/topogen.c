@@ -0,0 +1,72 @@
+/* ******************************************************************
+ topogen: write a random network, or a scenario of link flaps for it.
+
+   topogen [-s seed] [-c chords] nodes > net.topo
+   topogen [-s seed] [-c chords] -F flaps nodes > flaps.scn
+
+ The network is a ring through every node plus chords links between
+ random pairs (as many as there are nodes by default), costing 1..20.
+ With -F the same network (same seed and chords) is generated, and
+ flaps links picked at random go down (cost 999) and come back to their
+ cost a little later, every 20 time units on average from t=1000.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "topology.h"
+#include "rng.h"
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-s seed] [-c chords] [-F flaps] nodes\n", prog);
+  exit(1);
+}
+
+static void flaps(const struct topology *t, int n, uint64_t seed)
+{
+  double time = 1000.0;
+  int i, e, a;
+
+  if (t->nedges == 0)
+    return;
+  printf("# %d link flaps\n", n);
+  for (i = 0; i < n; i++) {
+    time += -20.0 * log(1.0 - rng_float(splitmix64(&seed)));
+    e = (int)(splitmix64(&seed) % t->nedges);
+    for (a = 0; t->rowstart[a + 1] <= e; a++)
+      ;
+    printf("%.3f %d %d 999\n", time, a, t->adj[e]);
+    printf("%.3f %d %d %d\n", time + 1.0 + 29.0 * rng_float(splitmix64(&seed)),
+           a, t->adj[e], t->cost[e]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  struct topology *t;
+  uint64_t seed = 1;
+  int c, nnodes, chords = -1, nflaps = -1;
+
+  while ((c = getopt(argc, argv, "s:c:F:")) != -1) {
+    switch (c) {
+      case 's': seed = strtoull(optarg, NULL, 0); break;
+      case 'c': chords = atoi(optarg); break;
+      case 'F': nflaps = atoi(optarg); break;
+      default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || (nnodes = atoi(argv[optind])) < 1)
+    usage(argv[0]);
+  t = topo_random(nnodes, chords >= 0 ? chords : nnodes, seed);
+  if (t == NULL)
+    return 1;
+  if (nflaps >= 0)
+    flaps(t, nflaps, seed ^ 0x5c0e7a11ULL);
+  else
+    topo_write(t, stdout);
+  topo_free(t);
+  return 0;
+}
@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "topology.h"
+#include "rng.h"
+
+#define MAXCOST 998          /* 999 means "not connected" */
+
+const struct linkmodel topo_defaultlink = { 0.0, 2.0, 0.0, 0, 0.0 };
+
+struct halfedge {
+  int to;
+  int cost;
+};
+
+static int cmphalfedge(const void *a, const void *b)
+{
+  const struct halfedge *x = a, *y = b;
+
+  return (x->to > y->to) - (x->to < y->to);
+}
+
+/* build the CSR arrays from a list of undirected links */
+struct topology *topo_fromedges(int nnodes, int nlinks, const int (*links)[3])
+{
+  struct topology *t;
+  struct halfedge *row;
+  int *fill;
+  int i, k, a, b, n, maxdeg;
+
+  t = calloc(1, sizeof(struct topology));
+  if (t == NULL)
+    return NULL;
+  t->nnodes = nnodes;
+  t->nedges = 2 * nlinks;
+  t->rowstart = calloc(nnodes + 1, sizeof(int));
+  t->adj = malloc((t->nedges ? t->nedges : 1) * sizeof(int));
+  t->cost = malloc((t->nedges ? t->nedges : 1) * sizeof(int));
+  fill = calloc(nnodes ? nnodes : 1, sizeof(int));
+  if (t->rowstart == NULL || t->adj == NULL || t->cost == NULL || fill == NULL)
+    goto fail;
+
+  for (k = 0; k < nlinks; k++) {
+    t->rowstart[links[k][0] + 1]++;
+    t->rowstart[links[k][1] + 1]++;
+  }
+  maxdeg = 0;
+  for (i = 0; i < nnodes; i++) {
+    if (t->rowstart[i + 1] > maxdeg)
+      maxdeg = t->rowstart[i + 1];
+    t->rowstart[i + 1] += t->rowstart[i];
+  }
+  for (k = 0; k < nlinks; k++) {
+    a = links[k][0];
+    b = links[k][1];
+    t->adj[t->rowstart[a] + fill[a]] = b;
+    t->cost[t->rowstart[a] + fill[a]++] = links[k][2];
+    t->adj[t->rowstart[b] + fill[b]] = a;
+    t->cost[t->rowstart[b] + fill[b]++] = links[k][2];
+  }
+  free(fill);
+
+  /* sort every row by neighbor so lookups can bisect */
+  row = malloc((maxdeg ? maxdeg : 1) * sizeof(struct halfedge));
+  if (row == NULL)
+    goto fail;
+  for (i = 0; i < nnodes; i++) {
+    n = topo_degree(t, i);
+    for (k = 0; k < n; k++) {
+      row[k].to = t->adj[t->rowstart[i] + k];
+      row[k].cost = t->cost[t->rowstart[i] + k];
+    }
+    qsort(row, n, sizeof(struct halfedge), cmphalfedge);
+    for (k = 0; k < n; k++) {
+      if (k > 0 && row[k].to == row[k - 1].to) {
+        printf("topology: link %d-%d given twice\n", i, row[k].to);
+        free(row);
+        topo_free(t);
+        return NULL;
+      }
+      t->adj[t->rowstart[i] + k] = row[k].to;
+      t->cost[t->rowstart[i] + k] = row[k].cost;
+    }
+  }
+  free(row);
+  return t;
+
+fail:
+  free(fill);
+  topo_free(t);
+  return NULL;
+}
+
+/* the key=value attributes in s into m; 0 if one is not understood */
+static int parselink(char *s, struct linkmodel *m)
+{
+  char *tok, key[16];
+  double v;
+  int n;
+
+  for (tok = strtok(s, " \t\r\n"); tok != NULL;
+       tok = strtok(NULL, " \t\r\n")) {
+    if (sscanf(tok, "%15[a-z]=%lf%n", key, &v, &n) != 2 || tok[n] != '\0' ||
+        v < 0.0)
+      return 0;
+    if (strcmp(key, "delay") == 0)
+      m->delay = v;
+    else if (strcmp(key, "jitter") == 0)
+      m->jitter = v;
+    else if (strcmp(key, "bw") == 0)
+      m->bandwidth = v;
+    else if (strcmp(key, "queue") == 0 && v == (int)v)
+      m->queue = (int)v;
+    else if (strcmp(key, "loss") == 0 && v < 1.0)
+      m->loss = v;
+    else
+      return 0;
+  }
+  return 1;
+}
+
+struct topology *topo_load(const char *path)
+{
+  struct topology *t;
+  FILE *fp;
+  char line[256], *p;
+  int (*links)[3], (*grown)[3];
+  struct linkmodel *models, *grownm, model;
+  int nlinks, cap, nnodes, declared, lineno, a, b, c, k, n, anymodel;
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+    printf("topology: can not open %s\n", path);
+    return NULL;
+  }
+  links = NULL;
+  models = NULL;
+  nlinks = cap = 0;
+  nnodes = 0;
+  declared = -1;
+  lineno = 0;
+  model = topo_defaultlink;
+  anymodel = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    lineno++;
+    if ((p = strchr(line, '#')) != NULL)
+      *p = '\0';
+    for (p = line; *p == ' ' || *p == '\t'; p++)
+      ;
+    if (*p == '\0' || *p == '\n' || *p == '\r')
+      continue;
+    if (sscanf(p, "nodes %d", &declared) == 1)
+      continue;
+    if (strncmp(p, "default", 7) == 0) {
+      model = topo_defaultlink;
+      if (!parselink(p + 7, &model)) {
+        printf("topology: %s:%d: expected \"default\" and key=value link "
+               "attributes\n", path, lineno);
+        goto fail;
+      }
+      continue;
+    }
+    if (sscanf(p, "%d %d %d%n", &a, &b, &c, &n) != 3 || a < 0 || b < 0 ||
+        a == b || c < 0 || c > MAXCOST) {
+      printf("topology: %s:%d: expected \"node node cost\" with distinct "
+             "nodes and 0 <= cost <= %d\n", path, lineno, MAXCOST);
+      goto fail;
+    }
+    if (nlinks == cap) {
+      cap = cap ? 2 * cap : 256;
+      grown = realloc(links, cap * sizeof(*links));
+      if (grown != NULL)
+        links = grown;
+      grownm = realloc(models, cap * sizeof(*models));
+      if (grownm != NULL)
+        models = grownm;
+      if (grown == NULL || grownm == NULL) {
+        printf("topology: out of memory reading %s\n", path);
+        goto fail;
+      }
+    }
+    links[nlinks][0] = a;
+    links[nlinks][1] = b;
+    links[nlinks][2] = c;
+    models[nlinks] = model;
+    if (!parselink(p + n, &models[nlinks])) {
+      printf("topology: %s:%d: link attributes are delay=, jitter=, bw=, "
+             "queue= and loss=, none below 0 and loss below 1\n", path,
+             lineno);
+      goto fail;
+    }
+    if (memcmp(&models[nlinks], &topo_defaultlink, sizeof(model)) != 0)
+      anymodel = 1;
+    nlinks++;
+    if (a >= nnodes)
+      nnodes = a + 1;
+    if (b >= nnodes)
+      nnodes = b + 1;
+  }
+  fclose(fp);
+  fp = NULL;
+  if (declared >= 0) {
+    if (declared < nnodes) {
+      printf("topology: %s declares %d nodes but uses node %d\n",
+             path, declared, nnodes - 1);
+      goto fail;
+    }
+    nnodes = declared;
+  }
+  if (nnodes == 0) {
+    printf("topology: %s has no nodes\n", path);
+    goto fail;
+  }
+  t = topo_fromedges(nnodes, nlinks, (const int (*)[3])links);
+  if (t != NULL && anymodel) {
+    t->link = malloc((t->nedges ? t->nedges : 1) * sizeof(struct linkmodel));
+    if (t->link == NULL) {
+      printf("topology: out of memory reading %s\n", path);
+      topo_free(t);
+      t = NULL;
+    }
+    for (k = 0; t != NULL && k < nlinks; k++) {
+      t->link[topo_edge(t, links[k][0], links[k][1])] = models[k];
+      t->link[topo_edge(t, links[k][1], links[k][0])] = models[k];
+    }
+  }
+  free(links);
+  free(models);
+  return t;
+
+fail:
+  if (fp != NULL)
+    fclose(fp);
+  free(links);
+  free(models);
+  return NULL;
+}
+
+static int cmplink(const void *a, const void *b)
+{
+  const int *x = a, *y = b;
+
+  if (x[0] != y[0])
+    return (x[0] > y[0]) - (x[0] < y[0]);
+  return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+/* a ring, so every node is reachable, plus chords links between random
+   pairs of nodes, with costs 1..20 */
+struct topology *topo_random(int nnodes, int chords, uint64_t seed)
+{
+  struct topology *t;
+  int (*links)[3];
+  int i, n, k, a, b;
+
+  links = malloc(((size_t)nnodes + chords + 1) * sizeof(*links));
+  if (links == NULL)
+    return NULL;
+  n = 0;
+  for (i = 0; i < nnodes && nnodes > 1; i++) {
+    if (nnodes == 2 && i == 1)
+      break;                        /* a ring of two is one link */
+    links[n][0] = i;
+    links[n++][1] = (i + 1) % nnodes;
+  }
+  for (i = 0; i < chords && nnodes > 2; i++) {
+    a = (int)(splitmix64(&seed) % nnodes);
+    b = (int)(splitmix64(&seed) % nnodes);
+    if (a != b) {
+      links[n][0] = a;
+      links[n++][1] = b;
+    }
+  }
+  /* one link per pair, lower id first */
+  for (i = 0; i < n; i++)
+    if (links[i][0] > links[i][1]) {
+      a = links[i][0];
+      links[i][0] = links[i][1];
+      links[i][1] = a;
+    }
+  qsort(links, n, sizeof(*links), cmplink);
+  for (i = k = 0; i < n; i++)
+    if (k == 0 || cmplink(links[i], links[k - 1]) != 0) {
+      links[k][0] = links[i][0];
+      links[k][1] = links[i][1];
+      links[k++][2] = 1 + (int)(splitmix64(&seed) % 20);
+    }
+  t = topo_fromedges(nnodes, k, (const int (*)[3])links);
+  free(links);
+  return t;
+}
+
+/* in the format topo_load() reads, with the attributes of each link
+   that are not the default */
+void topo_write(const struct topology *t, FILE *fp)
+{
+  const struct linkmodel *m, *d = &topo_defaultlink;
+  int i, e;
+
+  fprintf(fp, "nodes %d\n", t->nnodes);
+  for (i = 0; i < t->nnodes; i++)
+    for (e = t->rowstart[i]; e < t->rowstart[i + 1]; e++) {
+      if (t->adj[e] < i)
+        continue;
+      fprintf(fp, "%d %d %d", i, t->adj[e], t->cost[e]);
+      m = topo_link(t, e);
+      if (m->delay != d->delay)
+        fprintf(fp, " delay=%g", m->delay);
+      if (m->jitter != d->jitter)
+        fprintf(fp, " jitter=%g", m->jitter);
+      if (m->bandwidth != d->bandwidth)
+        fprintf(fp, " bw=%g", m->bandwidth);
+      if (m->queue != d->queue)
+        fprintf(fp, " queue=%d", m->queue);
+      if (m->loss != d->loss)
+        fprintf(fp, " loss=%g", m->loss);
+      fprintf(fp, "\n");
+    }
+}
+
+void topo_free(struct topology *t)
+{
+  if (t == NULL)
+    return;
+  free(t->rowstart);
+  free(t->adj);
+  free(t->cost);
+  free(t->link);
+  free(t);
+}
+
+int topo_edge(const struct topology *t, int from, int to)
+{
+  int lo, hi, mid;
+
+  lo = t->rowstart[from];
+  hi = t->rowstart[from + 1] - 1;
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (t->adj[mid] == to)
+      return mid;
+    if (t->adj[mid] < to)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
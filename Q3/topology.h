@@ -0,0 +1,61 @@
+/* ******************************************************************
+ Network topology, loaded once and shared by the emulator and the
+ routers.  Links are kept in compressed sparse row form: the links of
+ node i are entries rowstart[i] .. rowstart[i+1]-1 of adj[] and cost[],
+ sorted by neighbor id, so memory is O(nodes + links) and a neighbor
+ lookup is a binary search over one row.
+
+ Topology files hold one undirected link per line,
+
+     # comment
+     nodes 4          optional, otherwise the largest id + 1
+     0 1 1            node, node, cost
+     0 2 3 bw=400 queue=8      the same, with how the link carries packets
+     default delay=0.5 jitter=0    for the links on the lines after it
+
+ and each link appears in the CSR arrays once in each direction.  The
+ attributes of a link, struct linkmodel below, are delay=, jitter=, bw=,
+ queue= and loss=; any left out are those of the last "default" line,
+ or of the assignment's medium.
+**********************************************************************/
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* how a link carries packets, the same way in both directions */
+struct linkmodel {
+  float delay;         /* propagation delay, in time units */
+  float jitter;        /* plus up to this much more, at random */
+  float bandwidth;     /* bytes per time unit, 0 for no limit */
+  int queue;           /* packets waiting for the link or being sent on
+                          it at most, 0 for no limit */
+  float loss;          /* probability that a packet is lost */
+};
+
+/* the assignment's medium: 0 to 2 time units, nothing lost */
+extern const struct linkmodel topo_defaultlink;
+
+struct topology {
+  int nnodes;
+  int nedges;          /* directed edges, two per link */
+  int *rowstart;       /* nnodes+1 offsets into adj[] and cost[] */
+  int *adj;            /* neighbor at the far end of each edge */
+  int *cost;           /* cost of each edge */
+  struct linkmodel *link;  /* of each edge, NULL if all are the default */
+};
+
+struct topology *topo_load(const char *path);     /* NULL on error */
+struct topology *topo_fromedges(int nnodes, int nlinks, const int (*links)[3]);
+struct topology *topo_random(int nnodes, int chords, uint64_t seed);
+void topo_write(const struct topology *t, FILE *fp);
+void topo_free(struct topology *t);
+
+/* index of edge from->to in adj[]/cost[], or -1 if not neighbors */
+int topo_edge(const struct topology *t, int from, int to);
+
+#define topo_degree(t, i)  ((t)->rowstart[(i) + 1] - (t)->rowstart[i])
+#define topo_link(t, e)  ((t)->link != NULL ? &(t)->link[e] : &topo_defaultlink)
+
+#endif
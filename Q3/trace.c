@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+static FILE *tracefile;
+static pthread_mutex_t tracelock = PTHREAD_MUTEX_INITIALIZER;
+
+int trace_open(const char *path, int nnodes, int nlps)
+{
+  struct tracehdr h;
+
+  tracefile = fopen(path, "wb");
+  if (tracefile == NULL) {
+    perror(path);
+    return 0;
+  }
+  h.magic = TRACE_MAGIC;
+  h.version = TRACE_VERSION;
+  h.nnodes = nnodes;
+  h.nlps = nlps;
+  if (fwrite(&h, sizeof(h), 1, tracefile) != 1) {
+    perror(path);
+    fclose(tracefile);
+    tracefile = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+void trace_close(void)
+{
+  if (tracefile != NULL)
+    fclose(tracefile);
+  tracefile = NULL;
+}
+
+void trace_initbuf(struct tracebuf *b)
+{
+  b->n = 0;
+  b->rec = NULL;
+  if (tracefile == NULL)
+    return;
+  b->rec = malloc(TRACE_BUFRECS * sizeof(struct tracerec));
+  if (b->rec == NULL) {
+    printf("Panic: out of memory for a trace buffer\n");
+    exit(1);
+  }
+}
+
+/* lps flush whenever their buffer fills, so the file is shared */
+void trace_flush(struct tracebuf *b)
+{
+  if (b->n == 0)
+    return;
+  pthread_mutex_lock(&tracelock);
+  fwrite(b->rec, sizeof(struct tracerec), b->n, tracefile);
+  pthread_mutex_unlock(&tracelock);
+  b->n = 0;
+}
+
+void trace_freebuf(struct tracebuf *b)
+{
+  if (b->rec == NULL)
+    return;
+  trace_flush(b);
+  free(b->rec);
+  b->rec = NULL;
+}
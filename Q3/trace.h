@@ -0,0 +1,68 @@
+/* ******************************************************************
+ Binary event trace.  Instead of formatting text as it goes, the
+ emulator appends a fixed-size record per event to a buffer of its
+ logical process; full buffers are written to the trace file in one
+ fwrite.  dvtrace turns a trace file back into text, or into Chrome
+ trace JSON for Perfetto (ui.perfetto.dev) or chrome://tracing.
+
+ A file is a struct tracehdr followed by records.  Each lp writes its
+ own records in the order it made them, in whole buffers, so records
+ of different lps interleave a buffer at a time.
+**********************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC     0x52545644u      /* "DVTR" */
+#define TRACE_VERSION   2
+#define TRACE_BUFRECS   (64 * 1024)     /* records per lp buffer */
+
+struct tracehdr {
+  uint32_t magic;
+  uint32_t version;
+  int32_t nnodes;
+  int32_t nlps;
+};
+
+enum {
+  TR_RECV = 1,        /* a packet is delivered to node */
+  TR_SEND,            /* node hands a packet to layer 2 */
+  TR_LINK,            /* node learns a link cost changed */
+  TR_TIMER,           /* a timer of node runs out */
+  TR_DROP,            /* a packet node sent was dropped or lost */
+};
+
+struct tracerec {
+  float time;         /* simulated time of the event */
+  float arrival;      /* TR_SEND: when the packet will be delivered */
+  uint16_t type;
+  uint16_t lp;        /* which lp made the record */
+  int32_t node;       /* router the event happened at */
+  int32_t peer;       /* TR_RECV: sender, TR_SEND, TR_DROP: receiver,
+                         TR_LINK: other end, TR_TIMER: the argument */
+  int32_t value;      /* TR_RECV, TR_SEND, TR_DROP: entries in the packet,
+                         TR_LINK: the new cost */
+};
+
+struct tracebuf {
+  struct tracerec *rec;   /* NULL when not tracing */
+  int n;
+};
+
+/* writing side, used by the emulator */
+int trace_open(const char *path, int nnodes, int nlps);  /* 0 on error */
+void trace_close(void);
+void trace_initbuf(struct tracebuf *b);
+void trace_flush(struct tracebuf *b);
+void trace_freebuf(struct tracebuf *b);          /* flushes first */
+
+/* the next free record of b, flushing it first if it is full */
+static inline struct tracerec *trace_next(struct tracebuf *b)
+{
+  if (b->n == TRACE_BUFRECS)
+    trace_flush(b);
+  return &b->rec[b->n++];
+}
+
+#endif
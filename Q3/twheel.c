@@ -0,0 +1,184 @@
+#include <stddef.h>
+
+#include "twheel.h"
+
+void wheel_init(struct twheel *w, uint64_t now)
+{
+  int l, s;
+
+  w->now = now;
+  w->count = 0;
+  for (l = 0; l < WHEEL_LEVELS; l++) {
+    w->occupied[l] = 0;
+    for (s = 0; s < WHEEL_SLOTS; s++)
+      w->slots[l][s].next = w->slots[l][s].prev = &w->slots[l][s];
+  }
+}
+
+/* link t at the end of the slot its expiry falls in */
+static void place(struct twheel *w, struct wtimer *t)
+{
+  uint64_t diff = t->expires ^ w->now;
+  struct wlink *head;
+  int l;
+
+  l = diff ? (63 - __builtin_clzll(diff)) / WHEEL_BITS : 0;
+  t->level = l;
+  t->slot = (t->expires >> (WHEEL_BITS * l)) & (WHEEL_SLOTS - 1);
+  head = &w->slots[l][t->slot];
+  t->link.prev = head->prev;
+  t->link.next = head;
+  head->prev->next = &t->link;
+  head->prev = &t->link;
+  w->occupied[l] |= 1ULL << t->slot;
+}
+
+static void unhook(struct twheel *w, struct wtimer *t)
+{
+  t->link.prev->next = t->link.next;
+  t->link.next->prev = t->link.prev;
+  if (w->slots[t->level][t->slot].next == &w->slots[t->level][t->slot])
+    w->occupied[t->level] &= ~(1ULL << t->slot);
+}
+
+void wheel_arm(struct twheel *w, struct wtimer *t, uint64_t expires)
+{
+  if (t->state == WT_ARMED)
+    unhook(w, t);
+  else
+    w->count++;
+  if (expires < w->now)
+    expires = w->now;
+  if (expires > WHEEL_MAXTICK)
+    expires = WHEEL_MAXTICK;
+  t->expires = expires;
+  t->state = WT_ARMED;
+  place(w, t);
+}
+
+void wheel_cancel(struct twheel *w, struct wtimer *t)
+{
+  if (t->state == WT_ARMED) {
+    unhook(w, t);
+    w->count--;
+  }
+  t->state = WT_IDLE;
+}
+
+/* the first level with an occupied slot at or after the clock's digit
+   there has the earliest: anything higher up starts after the end of
+   its range */
+uint64_t wheel_next(const struct twheel *w)
+{
+  uint64_t ahead;
+  int l, shift, digit;
+
+  for (l = 0; l < WHEEL_LEVELS; l++) {
+    if (w->occupied[l] == 0)
+      continue;
+    shift = WHEEL_BITS * l;
+    digit = (w->now >> shift) & (WHEEL_SLOTS - 1);
+    ahead = w->occupied[l] & (~0ULL << digit);
+    if (ahead != 0)
+      return ((w->now >> shift >> WHEEL_BITS << WHEEL_BITS) |
+              (uint64_t)__builtin_ctzll(ahead)) << shift;
+  }
+  return UINT64_MAX;
+}
+
+/* take the timers out of a slot, in the order they went in */
+static struct wlink *detach(struct twheel *w, int l, int s, struct wlink *end)
+{
+  struct wlink *head = &w->slots[l][s], *first;
+
+  first = head->next;
+  head->prev->next = end;
+  head->next = head->prev = head;
+  w->occupied[l] &= ~(1ULL << s);
+  return first;
+}
+
+static int before(const struct wtimer *a, const struct wtimer *b)
+{
+  return a->node != b->node ? a->node < b->node : a->arg < b->arg;
+}
+
+/* merge sort of a nextfired list */
+static struct wtimer *sortfired(struct wtimer *list)
+{
+  struct wtimer *a, *b, *slow, *fast, head, *tail;
+
+  if (list == NULL || list->nextfired == NULL)
+    return list;
+  slow = list;
+  for (fast = list->nextfired; fast != NULL && fast->nextfired != NULL;
+       fast = fast->nextfired->nextfired)
+    slow = slow->nextfired;
+  b = sortfired(slow->nextfired);
+  slow->nextfired = NULL;
+  a = sortfired(list);
+  tail = &head;
+  while (a != NULL && b != NULL)
+    if (before(b, a)) {
+      tail->nextfired = b;
+      tail = b;
+      b = b->nextfired;
+    } else {
+      tail->nextfired = a;
+      tail = a;
+      a = a->nextfired;
+    }
+  tail->nextfired = a != NULL ? a : b;
+  return head.nextfired;
+}
+
+#define TIMEROF(p)  ((struct wtimer *)((char *)(p) - offsetof(struct wtimer, link)))
+
+struct wtimer *wheel_expire(struct twheel *w, uint64_t tick)
+{
+  struct wlink *p, *next, end;
+  struct wtimer *t, *fired;
+  int l, s;
+
+  w->now = tick;
+  /* slots starting at tick move down, highest level first, so that
+     what comes down to level 0 goes off below */
+  for (l = WHEEL_LEVELS - 1; l > 0; l--) {
+    if (tick & ((1ULL << (WHEEL_BITS * l)) - 1))
+      continue;
+    s = (tick >> (WHEEL_BITS * l)) & (WHEEL_SLOTS - 1);
+    if (!(w->occupied[l] & (1ULL << s)))
+      continue;
+    for (p = detach(w, l, s, &end); p != &end; p = next) {
+      next = p->next;
+      place(w, TIMEROF(p));
+    }
+  }
+  s = tick & (WHEEL_SLOTS - 1);
+  if (!(w->occupied[0] & (1ULL << s)))
+    return NULL;
+  fired = NULL;
+  for (p = detach(w, 0, s, &end); p != &end; p = next) {
+    next = p->next;
+    t = TIMEROF(p);
+    t->state = WT_FIRING;
+    t->nextfired = fired;
+    fired = t;
+    w->count--;
+  }
+  return sortfired(fired);
+}
+
+struct wtimer *wheel_take(struct wtimer **fired)
+{
+  struct wtimer *t;
+
+  while ((t = *fired) != NULL) {
+    *fired = t->nextfired;
+    if (t->state == WT_FIRING) {
+      t->state = WT_IDLE;
+      return t;
+    }
+  }
+  return NULL;
+}
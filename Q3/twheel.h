@@ -0,0 +1,69 @@
+/* ******************************************************************
+ Hierarchical timing wheel (G. Varghese and T. Lauck, SOSP 1987) for
+ timers that are armed and cancelled far more often than they go off,
+ like the routers' route timeouts, which every update pushes back.
+
+ Time is counted in ticks.  Level l has 64 slots of 64^l ticks each,
+ and a timer sits at the lowest level where its expiry and the wheel's
+ clock agree on every digit above that level's, so arming and
+ cancelling are O(1) list operations.  When the clock reaches a slot
+ of a higher level its timers move down, at most once per level.
+ Bitmaps of the occupied slots find the next tick with something to do
+ without visiting the empty ones.
+
+ The timers belong to the caller and are linked into the wheel, which
+ allocates nothing.
+**********************************************************************/
+#ifndef TWHEEL_H
+#define TWHEEL_H
+
+#include <stdint.h>
+
+#define WHEEL_BITS      6
+#define WHEEL_SLOTS     (1 << WHEEL_BITS)
+#define WHEEL_LEVELS    8
+#define WHEEL_MAXTICK   ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+struct wlink {
+  struct wlink *next, *prev;
+};
+
+enum { WT_IDLE, WT_ARMED, WT_FIRING };
+
+struct wtimer {
+  struct wlink link;          /* in its slot, while armed */
+  uint64_t expires;           /* the tick it goes off at */
+  int node;                   /* the caller's: whose timer it is */
+  int arg;                    /*   and what for */
+  unsigned char state;        /* one of the above */
+  unsigned char level, slot;
+  struct wtimer *nextfired;   /* in the list from wheel_expire() */
+};
+
+struct twheel {
+  uint64_t now;               /* every timer due before it has gone off */
+  long count;                 /* timers armed */
+  uint64_t occupied[WHEEL_LEVELS];  /* a bit per non-empty slot */
+  struct wlink slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+void wheel_init(struct twheel *w, uint64_t now);
+static inline void wtimer_init(struct wtimer *t)
+{
+  t->state = WT_IDLE;
+}
+/* arm t, or move it if it is armed, to go off at tick expires; a tick
+   already past means the current one */
+void wheel_arm(struct twheel *w, struct wtimer *t, uint64_t expires);
+void wheel_cancel(struct twheel *w, struct wtimer *t);
+/* the next tick with something to do, UINT64_MAX if no timer is armed */
+uint64_t wheel_next(const struct twheel *w);
+/* move the clock to tick, which must be wheel_next(), and return the
+   timers due there, ordered by node and arg so that the order does not
+   depend on when they were armed.  Take them one at a time with
+   wheel_take(): a timer of the list that is armed again or cancelled
+   before its turn is skipped. */
+struct wtimer *wheel_expire(struct twheel *w, uint64_t tick);
+struct wtimer *wheel_take(struct wtimer **fired);
+
+#endif